@@ -12,6 +12,10 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #define  SPIFLASH_SPI_STATREAD          0x02
 #define  SPIFLASH_SPI_DATAWRITE         0x01
 #define  SPIFLASH_SPI_DATAREAD          0x03
@@ -21,13 +25,25 @@
 #define  SPIFLASH_STAT_BUSY             0x01   // Erase/Write in Progress
 #define  SPIFLASH_STAT_WRTEN            0x02   // Write Enable Latch
 
-// SPI Flash Characteristics (S25FL Specific)
+// Flash status register 2 bits
+#define S25FL_STAT2_PS                  0x01   // Program Suspend
+#define S25FL_STAT2_ES                  0x02   // Erase Suspend
+#define S25FL_STAT2_P_ERR               0x20   // Program Error
+#define S25FL_STAT2_E_ERR               0x40   // Erase Error
+
+// Flash configuration register 1 bits
+#define S25FL_CONFIG_QUAD               0x02   // Quad Enable
+
+// SPI Flash Characteristics (S25FL064L). El driver usa la tabla de perfiles
+// (ver s25fl_profile_t) segun el memory_size configurado.
 #define S25FL_MAXADDRESS                0x07FFFFF
-#define S25FL_MAX_ADDRESS_SIZE          3      // bytes address size
+#define S25FL_MAX_ADDRESS_SIZE          4      // bytes address size (4 en memorias de mas de 16 MB)
+#define S25FL_MAX_LATENCY_SIZE          4      // Bytes de modo y latencia que admite el encabezado de una lectura
 #define S25FL_PAGESIZE                  256    // 256 bytes per programmable page
 #define S25FL_PAGES                     32768  // 8,388,608 Bytes / 256 bytes per page
 #define S25FL_SECTORSIZE                4096   // 1 erase sector = 4096 bytes
 #define S25FL_SECTORS                   2048    // 8,388,608 Bytes / 4096 bytes per sector
+#define S25FL_BLOCK32SIZE               32768  // 1 half block = 32K bytes
 #define S25FL_BLOCKSIZE                 65536  // 1 erase block = 64K bytes
 #define S25FL_BLOCKS                    128     // 8,388,608 Bytes / 4096 bytes per sector
 #define S25FL_MANUFACTURERID            0x01   // Used to validate read data
@@ -38,12 +54,19 @@
 #define S25FL_CMD_WRITEDISABLE          0x04   // Write Disabled
 #define S25FL_CMD_READSTAT1             0x05   // Read Status Register 1
 #define S25FL_CMD_READSTAT2             0x07   // Read Status Register 2
+#define S25FL_CMD_READCONFIG            0x35   // Read Configuration Register 1
 #define S25FL_CMD_WRITESTAT             0x01   // Write Status Register
+#define S25FL_CMD_CLSR                  0x30   // Clear Status Register (P_ERR y E_ERR)
 #define S25FL_CMD_PAGEPROG              0x02   // Page Program
 #define S25FL_CMD_QUADPAGEPROG          0x32   // Quad Page Program
 #define S25FL_CMD_SECTERASE4            0x20   // Sector Erase (4KB)
 #define S25FL_CMD_BLOCKERASE32          0x52   // Block Erase (32KB)
 #define S25FL_CMD_BLOCKERASE64          0xD8   // Block Erase (64KB)
+#define S25FL_CMD_PAGEPROG4             0x12   // Page Program, direccion de 4 bytes
+#define S25FL_CMD_QUADPAGEPROG4         0x34   // Quad Page Program, direccion de 4 bytes
+#define S25FL_CMD_SECTERASE4_4          0x21   // Sector Erase (4KB), direccion de 4 bytes
+#define S25FL_CMD_BLOCKERASE32_4        0x53   // Block Erase (32KB), direccion de 4 bytes
+#define S25FL_CMD_BLOCKERASE64_4        0xDC   // Block Erase (64KB), direccion de 4 bytes
 #define S25FL_CMD_CHIPERASE             0x60   // Chip Erase
 #define S25FL_CMD_ERASESUSPEND          0x75   // Erase Suspend
 #define S25FL_CMD_ERASERESUME           0x7A   // Erase Resume
@@ -56,6 +79,12 @@
 #define S25FL_CMD_FREADDUALIO           0xBB   // Fast Read Dual I/O
 #define S25FL_CMD_FREADQUADOUT          0x6B   // Fast Read Quad Output
 #define S25FL_CMD_FREADQUADIO           0xEB   // Fast Read Quad I/O
+#define S25FL_CMD_READ4                 0x13   // Read, direccion de 4 bytes
+#define S25FL_CMD_FREAD4                0x0C   // Fast Read, direccion de 4 bytes
+#define S25FL_CMD_FREADDUALOUT4         0x3C   // Fast Read Dual Output, direccion de 4 bytes
+#define S25FL_CMD_FREADDUALIO4          0xBC   // Fast Read Dual I/O, direccion de 4 bytes
+#define S25FL_CMD_FREADQUADOUT4         0x6C   // Fast Read Quad Output, direccion de 4 bytes
+#define S25FL_CMD_FREADQUADIO4          0xEC   // Fast Read Quad I/O, direccion de 4 bytes
 //#define S25FL_CMD_WREADQUADIO         0xE7   // Word Read Quad I/O
 //#define S25FL_CMD_OWREADQUADIO        0xE3   // Octal Word Read Quad I/O
 // ID/Security Instructions
@@ -65,10 +94,71 @@
 #define S25FL_CMD_MANUFDEVID4           0xAF   // Manufacturer/Device ID by Quad I/O
 #define S25FL_CMD_JEDECID               0x9F   // JEDEC ID
 #define S25FL_CMD_READUNIQUEID          0x4B   // Read Unique ID
+#define S25FL_CMD_READSFDP              0x5A   // Read SFDP
+
+// Tabla SFDP (JESD216), leida con direccion de 3 bytes y 8 ciclos de latencia
+#define S25FL_SFDP_SIGNATURE            0x50444653  // "SFDP"
+#define S25FL_SFDP_DUMMY_CYCLES         8
+#define S25FL_SFDP_BFPT_ID              0xFF00      // Tabla basica de parametros
+#define S25FL_SFDP_BFPT_MIN_DWORDS      9           // Hasta los tipos de borrado
+#define S25FL_SFDP_BFPT_DWORDS          16          // DWORDs de la tabla basica que usa el driver
 
 #define S25FL_ID_LEN                    3
 
+// Ciclos de modo y de latencia de los comandos de lectura (latency code por defecto)
+#define S25FL_FREAD_DUMMY_CYCLES        8
+#define S25FL_DUALOUT_DUMMY_CYCLES      8
+#define S25FL_QUADOUT_DUMMY_CYCLES      8
+#define S25FL_DUALIO_MODE_CYCLES        4
+#define S25FL_DUALIO_DUMMY_CYCLES       0
+#define S25FL_QUADIO_MODE_CYCLES        2
+#define S25FL_QUADIO_DUMMY_CYCLES       4
+#define S25FL_MODE_NORMAL               0x00   // Bits de modo que no activan la lectura continua
+#define S25FL_MODE_CONTINUOUS           0xA0   // Bits de modo (Axh) que dejan la memoria en lectura continua
+#define S25FL_CMD_MBR                   0xFF   // Mode Bit Reset: sale de la lectura continua
+#define S25FL_CMD_SBL                   0x77   // Set Burst Length: rafaga circular de Quad I/O Read
+#define S25FL_WRAP_DISABLE              0x10   // Byte de SBL que vuelve a la lectura lineal
+#define S25FL_WRAP_UNKNOWN              0xFF   // Rafaga circular desconocida (tras un reset del micro)
+
 #define READY_TIMEOUT                   2000
+#define S25FL_DMA_MIN_LEN               64     // Lecturas menores se hacen sin transferencia en segundo plano
+#define S25FL_VERIFY_CHUNK              64     // Bytes releidos por vez al verificar
+#define S25FL_READV_GAP                 16     // Huecos menores entre segmentos (por linea de datos) se
+                                               // leen y descartan en lugar de enviar otro comando
+#define S25FL_READV_SPAN                128    // Maximo de bytes leidos por comando al agrupar segmentos
+#define S25FL_STREAM_CHUNK              64     // Bytes entregados por vez al consumidor de una lectura continua
+#define S25FL_CACHE_LINE                32     // Bytes por linea de la cache de lectura (8, 16, 32 o 64,
+                                               // los largos de rafaga circular de la memoria)
+#define S25FL_CACHE_LINES               8      // Lineas de la cache de lectura (correspondencia directa)
+#define S25FL_CACHE_EMPTY               0xFFFFFFFF
+
+// Tiempos de programacion y borrado en microsegundos (tipico y maximo)
+#define S25FL_TPP_TYP_US                450         // Page Program
+#define S25FL_TPP_MAX_US                1350
+#define S25FL_TSE_TYP_US                45000       // Sector Erase 4 KB
+#define S25FL_TSE_MAX_US                400000
+#define S25FL_TBE32_TYP_US              150000      // Block Erase 32 KB
+#define S25FL_TBE32_MAX_US              600000
+#define S25FL_TBE64_TYP_US              220000      // Block Erase 64 KB
+#define S25FL_TBE64_MAX_US              1150000
+#define S25FL_TCE_TYP_US                18000000    // Chip Erase (S25FL064L)
+#define S25FL_TCE_MAX_US                72000000
+#define S25FL128_TCE_TYP_US             36000000    // Chip Erase (S25FL128L)
+#define S25FL128_TCE_MAX_US             144000000
+#define S25FL256_TCE_TYP_US             72000000    // Chip Erase (S25FL256L)
+#define S25FL256_TCE_MAX_US             288000000
+#define S25FL_TW_TYP_US                 145000      // Write Status/Config Register
+#define S25FL_TW_MAX_US                 1000000
+#define S25FL_TSL_MAX_US                40          // Latencia de suspension
+#define S25FL_TRS_MIN_US                100         // Minimo entre reanudacion y suspension
+#define S25FL_TDPD_US                   3           // Entrada en deep power-down
+#define S25FL_TRES1_US                  30          // Salida de deep power-down
+
+// Politica de espera: primera espera como porcentaje del tiempo tipico y
+// luego consultas cada (tipico / divisor) microsegundos, con un minimo
+#define S25FL_FIRST_POLL_PCT            90
+#define S25FL_POLL_DIVIDER              32
+#define S25FL_POLL_MIN_US               10
 
 typedef enum
 {
@@ -78,17 +168,231 @@ typedef enum
 
 typedef enum
 {
-    S64MB,
-    S128MB,
-    S256MB,
+    S64MB,          // S25FL064L, 8 MB
+    S128MB,         // S25FL128L, 16 MB
+    S256MB,         // S25FL256L, 32 MB, con direcciones de 4 bytes
 } s25fl_size_t;
 
+typedef enum
+{
+    S25FL_CLK_CONTROL = 0,  // Comandos de estado, habilitacion de escritura y borrado
+    S25FL_CLK_READ,         // Lectura normal (0x03), limitada a 50 MHz
+    S25FL_CLK_FAST,         // Fast Read y programacion de paginas, hasta 108 MHz
+} s25fl_clock_t;
+
+typedef enum
+{
+    S25FL_READ_NORMAL = 0,  // Comando de lectura 0x03
+    S25FL_READ_FAST,        // Comando de lectura 0x0B con byte de latencia
+    S25FL_READ_DUAL_OUT,    // 1-1-2: comando 0x3B
+    S25FL_READ_DUAL_IO,     // 1-2-2: comando 0xBB
+    S25FL_READ_QUAD_OUT,    // 1-1-4: comando 0x6B, requiere el bit QE
+    S25FL_READ_QUAD_IO,     // 1-4-4: comando 0xEB, requiere el bit QE
+    S25FL_READ_AUTO,        // El mas rapido que soporten la memoria y las lineas cableadas (max_lanes)
+} s25fl_read_mode_t;
+
+#define S25FL_READ_MODES                S25FL_READ_AUTO     // Cantidad de modos de lectura fijos
+
+typedef enum
+{
+    S25FL_PROG_SINGLE = 0,  // Page Program 0x02, datos por una linea
+    S25FL_PROG_QUAD,        // Quad Page Program 0x32, datos por 4 lineas, requiere el bit QE
+    S25FL_PROG_AUTO,        // Quad si la memoria lo soporta y hay 4 lineas cableadas
+} s25fl_prog_mode_t;
+
+// Comprobacion del resultado de programaciones y borrados
+typedef enum
+{
+    S25FL_VERIFY_SR2 = 0,   // Bits P_ERR y E_ERR del registro de estado 2 (por defecto)
+    S25FL_VERIFY_NONE,      // Sin comprobacion
+    S25FL_VERIFY_READBACK,  // SR2 y ademas se releen los datos programados o borrados
+} s25fl_verify_t;
+
+typedef enum
+{
+    S25FL_LANES_1 = 1,
+    S25FL_LANES_2 = 2,
+    S25FL_LANES_4 = 4,
+} s25fl_lanes_t;
+
+typedef enum
+{
+    S25FL_OP_NONE = 0,
+    S25FL_OP_PROGRAM,
+    S25FL_OP_ERASE_4K,
+    S25FL_OP_ERASE_32K,
+    S25FL_OP_ERASE_64K,
+    S25FL_OP_ERASE_CHIP,
+    S25FL_OP_WRITE_STATUS,
+    S25FL_OP_COUNT,
+} s25fl_op_t;
+
+// Tiempos tipico y maximo de una operacion en microsegundos
+typedef struct
+{
+    uint32_t typical;
+    uint32_t maximum;
+} s25fl_timing_t;
+
+// Parametros de un comando de lectura
+typedef struct
+{
+    uint8_t opcode;             // 0 si la memoria no soporta el modo
+    uint8_t opcode4;            // Variante con direccion de 4 bytes
+    s25fl_lanes_t addrLanes;    // Lineas usadas para la direccion, modo y latencia
+    s25fl_lanes_t dataLanes;    // Lineas usadas para los datos
+    uint8_t modeCycles;
+    uint8_t dummyCycles;
+} s25fl_read_cmd_t;
+
+// Caracteristicas de una memoria: descubiertas con la tabla SFDP o, si la
+// memoria no la tiene, tomadas de la tabla de modelos segun el JEDEC ID o
+// el memory_size configurado
+typedef struct
+{
+    uint32_t jedecId;
+    uint32_t capacity;                      // Bytes
+    uint32_t pageSize;
+    uint32_t sectorSize;                    // Borrado minimo
+    uint32_t block32Size;                   // 0 si no se soporta el borrado de 32 KB
+    uint32_t blockSize;                     // 0 si no se soporta el borrado de 64 KB
+    uint8_t addrBytes;                      // 4 en las memorias de mas de 16 MB
+    s25fl_timing_t timings[S25FL_OP_COUNT]; // Indexados por s25fl_op_t
+    uint8_t eraseOpcodes[S25FL_OP_COUNT];   // Comandos de borrado con direccion de 3 bytes
+    const s25fl_read_cmd_t *readCmds;       // Indexados por s25fl_read_mode_t
+} s25fl_profile_t;
+
+typedef enum
+{
+    S25FL_OK = 0,
+    S25FL_ERR_PARAM,            // Direccion, longitud o alineacion invalida
+    S25FL_ERR_BUSY,             // Ya hay otra operacion no bloqueante en curso
+    S25FL_ERR_WRITE_ENABLE,     // No se pudo habilitar la escritura
+    S25FL_ERR_TIMEOUT,          // Se supero el tiempo maximo de la operacion
+    S25FL_ERR_PROGRAM,          // La memoria reporto un error de programacion (P_ERR)
+    S25FL_ERR_ERASE,            // La memoria reporto un error de borrado (E_ERR)
+    S25FL_ERR_VERIFY,           // Los datos releidos no coinciden
+} s25fl_err_t;
+
+typedef enum
+{
+    S25FL_HANDLE_IDLE = 0,
+    S25FL_HANDLE_RUNNING,
+    S25FL_HANDLE_DONE,
+    S25FL_HANDLE_ERROR,
+} s25fl_handle_state_t;
+
+typedef enum
+{
+    S25FL_ASYNC_ERASE = 0,
+    S25FL_ASYNC_PROGRAM,
+    S25FL_ASYNC_READ,
+} s25fl_async_op_t;
+
+typedef struct s25fl_handle s25fl_handle_t;
+typedef void (*s25flCallback_t)(s25fl_handle_t *handle, void *ctx);
+
+// Consumidor de una lectura continua (ver S25FL_readStream). Devuelve false para cortarla.
+typedef bool (*s25flStream_t)(const uint8_t *data, uint32_t len, void *ctx);
+
+// Operacion no bloqueante de borrado o programacion (ver S25FL_poll)
+struct s25fl_handle
+{
+    s25fl_handle_state_t state;
+    s25fl_err_t error;
+    s25flCallback_t callback;   // Opcional (NULL): se llama al terminar, con o sin error
+    void *ctx;
+    uint32_t done;              // Bytes borrados o programados hasta el momento
+
+    // Uso interno del driver
+    s25fl_async_op_t op;
+    uint32_t address;
+    uint8_t *buffer;
+    uint32_t remaining;
+};
+
+// Acumulador de escrituras consecutivas pequeñas (ver S25FL_append)
+typedef struct
+{
+    uint32_t address;           // Direccion del proximo byte a agregar
+    uint32_t deadlineUs;        // Tiempo maximo que un byte espera en RAM (0: sin plazo)
+
+    // Uso interno del driver
+    uint8_t data[S25FL_PAGESIZE];  // Paginas mayores se programan de a S25FL_PAGESIZE
+    uint32_t start;             // Direccion del primer byte acumulado
+    uint32_t len;               // Bytes acumulados, todos en la misma pagina
+    uint32_t since;             // Momento en que se acumulo el primer byte
+} s25fl_append_t;
+
+// Segmento de una lectura dispersa (ver S25FL_readv)
+typedef struct
+{
+    uint32_t address;
+    uint8_t *buffer;
+    uint32_t len;
+} s25fl_segment_t;
+
+// Ventana de solo lectura sobre una region de la memoria (ver S25FL_map)
+typedef struct s25fl_map s25fl_map_t;
+struct s25fl_map
+{
+    const uint8_t *data;        // Los datos de la region, NULL si no esta mapeada
+    uint32_t address;
+    uint32_t len;
+    bool stale;                 // Se programo o borro parte de la region desde que se mapeo
+    s25fl_map_t *next;          // Siguiente ventana mapeada del mismo dispositivo
+};
+
+// Descripcion completa de un comando: el comando, la direccion, los bits de
+// modo, los ciclos de latencia y la fase de datos, en una sola transaccion
+// con CS habilitado. El comando siempre se envia por una sola linea.
+typedef struct
+{
+    uint8_t opcode;
+    uint8_t addrBytes;          // Bytes de direccion (0 si el comando no la lleva)
+    uint32_t address;
+    uint8_t modeCycles;         // Ciclos de los bits de modo (0 si no se envian)
+    uint8_t mode;
+    uint8_t dummyCycles;        // Ciclos de latencia antes de los datos
+    s25fl_lanes_t addrLanes;    // Lineas usadas para la direccion, modo y latencia
+    s25fl_lanes_t dataLanes;    // Lineas usadas para los datos
+    s25fl_clock_t clock;        // Clase de clock del comando
+    uint8_t *txData;            // Datos a escribir, o NULL
+    uint8_t *rxData;            // Donde guardar los datos leidos, o NULL
+    uint32_t len;               // Cantidad de bytes de datos
+    bool skipOpcode;            // No se envia el comando: la memoria esta en lectura continua
+    uint8_t wrap;               // Largo de la rafaga circular de una lectura quad I/O (0: lineal)
+} s25fl_xfer_t;
+
 typedef void (*csFunction_t)(csState_t);
 typedef unsigned char (*spiRead_t)(uint8_t*, uint32_t);
 typedef void (*spiWrite_t)(uint8_t*, uint32_t);
 typedef void (*spiWriteByte_t)(uint8_t);
 typedef uint8_t (*spiReadRegister_t)(uint8_t);
 typedef void (*delayFnc_t)(uint32_t);
+typedef void (*spiSetClock_t)(s25fl_clock_t);
+// Transferencia en segundo plano (por ejemplo por DMA) por una sola linea. Si
+// txBuffer es NULL se envian bytes 0xFF, si rxBuffer es NULL se descartan los
+// datos recibidos. El puerto debe llamar a done al terminar, aun desde una
+// interrupcion, pasandole ctx. Devuelve false si no se pudo iniciar.
+typedef void (*spiDone_t)(void *ctx);
+typedef bool (*spiAsync_t)(uint8_t *txBuffer, uint8_t *rxBuffer, uint32_t len, spiDone_t done, void *ctx);
+typedef void (*delayUsFnc_t)(uint32_t);
+typedef uint32_t (*timeUsFnc_t)(void);     // Contador libre en microsegundos
+// Transfiere len bytes usando la cantidad de lineas de datos indicada. Si txBuffer
+// no es NULL se escriben sus datos, si no, se leen los datos en rxBuffer.
+typedef void (*spiLanes_t)(s25fl_lanes_t lanes, uint8_t *txBuffer, uint8_t *rxBuffer, uint32_t len);
+// Realiza la transaccion descripta por xfer completa, sin vaciar el FIFO entre
+// las fases. El driver habilita CS antes y lo deshabilita despues. Devuelve false,
+// sin usar el bus, si el puerto no soporta la transaccion, en cuyo caso el driver
+// la arma con las demas funciones.
+typedef bool (*spiTransfer_t)(const s25fl_xfer_t *xfer);
+// Vista de solo lectura de la memoria en el espacio de direcciones (por
+// ejemplo un controlador mapeado en memoria). Devuelve un puntero a la region,
+// o NULL si no puede mapearla. La invalidacion se llama antes de programar o
+// borrar una region, para que el puerto descarte lo que tenga en cache.
+typedef const uint8_t* (*spiMmap_t)(uint32_t address, uint32_t len);
+typedef void (*spiMmapInvalidate_t)(uint32_t address, uint32_t len);
 
 typedef struct
 {
@@ -98,21 +402,183 @@ typedef struct
     spiWriteByte_t spi_writeByte_fnc;
     spiReadRegister_t spi_read_register;
     delayFnc_t delay_fnc;
-    s25fl_size_t memory_size;
+    delayUsFnc_t delay_us_fnc;      // Opcional (NULL): delay en microsegundos
+    timeUsFnc_t time_us_fnc;        // Opcional (NULL): tiempo en microsegundos
+    spiSetClock_t spi_set_clock;    // Opcional (NULL): cambia el clock SPI segun la clase de comando
+    spiLanes_t spi_lanes_fnc;       // Opcional (NULL): requerido por los modos de lectura y programacion dual/quad
+    spiAsync_t spi_async_fnc;       // Opcional (NULL): transferencias en segundo plano para lecturas y programaciones
+    spiTransfer_t spi_transfer_fnc; // Opcional (NULL): transacciones completas en una sola llamada
+    spiMmap_t spi_map_fnc;          // Opcional (NULL): ventanas mapeadas sin copia (ver S25FL_map)
+    spiMmapInvalidate_t spi_map_invalidate_fnc;  // Opcional (NULL): invalidacion de la vista mapeada
+    s25fl_size_t memory_size;       // Se usa solo si la memoria no tiene tabla SFDP ni un JEDEC ID conocido
+    s25fl_lanes_t max_lanes;        // Lineas de datos cableadas, para los modos automaticos (0: una)
+    s25fl_read_mode_t read_mode;
+    s25fl_prog_mode_t program_mode;
+    bool continuous_read;           // Lectura continua en los modos dual y quad I/O: las lecturas
+                                    // consecutivas envian solo la direccion
+    bool read_cache;                // Cache de lectura por lineas para las lecturas cortas
+    bool suspend_reads;             // Suspende borrados/programaciones en curso para atender lecturas
+    s25fl_verify_t verify;          // Comprobacion del resultado de programaciones y borrados
+    uint32_t idle_powerdown_us;     // Opcional (0): tiempo sin accesos tras el cual S25FL_idleTask pone la
+                                    // memoria en deep power-down, requiere time_us_fnc
 } s25fl_t;
 
+typedef enum
+{
+    S25FL_POWER_ACTIVE = 0,
+    S25FL_POWER_DOWN,           // Deep power-down: solo acepta el comando de salida
+    S25FL_POWER_WAKING,         // Comando de salida enviado, esperando tRES1
+} s25fl_power_state_t;
+
+// Contadores de la administracion de deep power-down, para ajustar el tiempo
+// sin accesos contra la latencia que agrega despertar a la memoria. Los
+// tiempos se miden solo si el puerto provee time_us_fnc.
+typedef struct
+{
+    uint64_t activeUs;          // Tiempo encendida, incluyendo la salida de deep power-down
+    uint64_t powerDownUs;       // Tiempo en deep power-down
+    uint32_t powerDowns;        // Entradas en deep power-down
+    uint32_t demandWakes;       // Salidas provocadas por un acceso
+    uint32_t hintedWakes;       // Salidas anticipadas con S25FL_wakeHint
+    uint64_t wakeWaitUs;        // Tiempo que los accesos esperaron a que la memoria despierte
+} s25fl_power_stats_t;
+
+// Fase de datos en segundo plano de la operacion no bloqueante, con CS habilitado
+typedef enum
+{
+    S25FL_DATA_NONE = 0,
+    S25FL_DATA_PROGRAM,
+    S25FL_DATA_READ,
+    S25FL_DATA_LINE,            // Resto de una linea de la cache leida en rafaga circular
+} s25fl_data_phase_t;
+
+// Linea de la cache de lectura
+typedef struct
+{
+    uint32_t address;           // Direccion de la linea, S25FL_CACHE_EMPTY si no tiene datos
+    uint8_t data[S25FL_CACHE_LINE];
+} s25fl_cache_line_t;
+
+// Contexto de una memoria: la configuracion del puerto y el estado seguido
+// por el driver. Se inicializa con S25FL_InitDriver y no debe modificarse
+// desde afuera. Varias memorias pueden compartir el bus SPI con CS distintos,
+// siempre que solo una a la vez tenga una fase de datos en segundo plano.
+typedef struct
+{
+    s25fl_t config;
+
+    // Geometria de la memoria, tomada del perfil
+    const s25fl_profile_t *profile;
+    s25fl_profile_t sfdp;       // Perfil descubierto con la tabla SFDP
+    s25fl_read_cmd_t sfdpReads[S25FL_READ_MODES];
+    int32_t pagesize;
+    int8_t addrsize;
+    int32_t pages;
+    uint32_t totalsize;
+
+    // Clase de clock SPI configurada actualmente en el puerto
+    s25fl_clock_t currentClock;
+    bool clockValid;
+
+    // Una operacion enviada sin esperar su finalizacion y el bit de
+    // habilitacion de escritura
+    bool busyPending;
+    bool welSet;
+
+    // Error de una operacion que termino sin que nadie la esperara, que se
+    // reporta en la proxima espera, y ultimo error reportado
+    s25fl_err_t opError;
+    s25fl_err_t lastError;
+
+    // Operacion en curso y momento en que se envio, para la politica de espera
+    s25fl_op_t pendingOp;
+    uint32_t opAddress;         // Region que modifica la operacion en curso, cuyos datos
+    uint32_t opLen;             // no son validos mientras esta suspendida (0: ninguna)
+    uint32_t opStart;
+    uint32_t opWaited;          // Tiempo esperado, si el puerto no provee time_us_fnc
+
+    // Suspension de borrado/programacion para atender lecturas
+    uint8_t suspendDepth;       // Lecturas anidadas que usan la misma suspension
+    uint32_t suspendStart;
+    uint32_t lastResume;
+    bool resumed;               // Si lastResume es valido
+
+    // Operacion no bloqueante en curso y su transferencia en segundo plano
+    s25fl_handle_t *activeHandle;
+    s25fl_data_phase_t dataPhase;
+    volatile bool asyncBusy;
+
+    // Deep power-down: estado, ultimo acceso y momento del ultimo cambio
+    s25fl_power_state_t powerState;
+    uint32_t lastAccess;
+    uint32_t powerSince;
+    uint32_t wakeStart;         // Envio del comando de salida
+    s25fl_power_stats_t powerStats;
+
+    // Paginas en 0xFF que no se programaron por no modificar la memoria
+    uint32_t blankPages;
+
+    // La ultima lectura envio los bits de modo de lectura continua
+    bool continuous;
+
+    // Cache de lectura y rafaga circular configurada en la memoria
+    s25fl_cache_line_t cache[S25FL_CACHE_LINES];
+    s25fl_cache_line_t *fillLine;   // Linea que completa la fase de datos S25FL_DATA_LINE
+    uint32_t fillAddress;
+    uint8_t fillOffset;             // Donde empezo la rafaga dentro de la linea
+    uint8_t fillLen;                // Bytes de la rafaga ya recibidos
+    uint8_t wrap;                   // Largo configurado con SBL (0: lectura lineal)
+    uint32_t cacheHits;
+    uint32_t cacheMisses;
+
+    // Ventanas mapeadas, que se marcan como desactualizadas al escribir
+    s25fl_map_t *maps;
+} s25fl_dev_t;
+
+
+bool S25FL_InitDriver(s25fl_dev_t *dev, s25fl_t config);
+uint8_t S25FL_readStatus(s25fl_dev_t *dev);
+uint8_t S25FL_readConfig(s25fl_dev_t *dev);
+bool S25FL_setQuadEnable(s25fl_dev_t *dev, bool enable);
+uint32_t S25FL_readDevID(s25fl_dev_t *dev);
+void S25FL_writeEnable (s25fl_dev_t *dev, bool enable);
+uint32_t S25FL_readBuffer (s25fl_dev_t *dev, uint32_t address, uint8_t *buffer, uint32_t len);
+uint32_t S25FL_readv (s25fl_dev_t *dev, s25fl_segment_t *segments, uint32_t count);
+uint32_t S25FL_readStream (s25fl_dev_t *dev, uint32_t address, uint32_t len, s25flStream_t consumer, void *ctx);
+const uint8_t* S25FL_map (s25fl_dev_t *dev, s25fl_map_t *map, uint32_t address, uint32_t len, uint8_t *buffer);
+void S25FL_unmap (s25fl_dev_t *dev, s25fl_map_t *map);
+bool S25FL_waitForReady(s25fl_dev_t *dev, uint32_t timeout);
+bool S25FL_waitForOperation(s25fl_dev_t *dev);
+bool S25FL_eraseSector (s25fl_dev_t *dev, uint32_t sectorNumber);
+bool S25FL_eraseRange (s25fl_dev_t *dev, uint32_t address, uint32_t length);
+bool S25FL_eraseSectors (s25fl_dev_t *dev, uint32_t firstSector, uint32_t count);
+uint32_t S25FL_writeBuffer(s25fl_dev_t *dev, uint32_t address, uint8_t *buffer, uint32_t len);
+uint32_t S25FL_writePage (s25fl_dev_t *dev, uint32_t address, uint8_t *buffer, uint32_t len, bool fastquit);
+void S25FL_appendInit (s25fl_dev_t *dev, s25fl_append_t *app, uint32_t address, uint32_t deadlineUs);
+uint32_t S25FL_append (s25fl_dev_t *dev, s25fl_append_t *app, const uint8_t *data, uint32_t len);
+bool S25FL_appendFlush (s25fl_dev_t *dev, s25fl_append_t *app);
+bool S25FL_appendPoll (s25fl_dev_t *dev, s25fl_append_t *app);
+s25fl_err_t S25FL_startErase (s25fl_dev_t *dev, s25fl_handle_t *handle, uint32_t address, uint32_t length, s25flCallback_t callback, void *ctx);
+s25fl_err_t S25FL_startProgram (s25fl_dev_t *dev, s25fl_handle_t *handle, uint32_t address, uint8_t *buffer, uint32_t len, s25flCallback_t callback, void *ctx);
+s25fl_err_t S25FL_startRead (s25fl_dev_t *dev, s25fl_handle_t *handle, uint32_t address, uint8_t *buffer, uint32_t len, s25flCallback_t callback, void *ctx);
+s25fl_handle_state_t S25FL_poll (s25fl_dev_t *dev, s25fl_handle_t *handle);
+void S25FL_releaseBus (s25fl_dev_t *dev);
+int32_t S25FL_pageSize(s25fl_dev_t *dev);
+int8_t S25FL_addressSize(s25fl_dev_t *dev);
+int32_t S25FL_numPages(s25fl_dev_t *dev);
+uint32_t S25FL_sectorSize(s25fl_dev_t *dev);
+uint32_t S25FL_capacity(s25fl_dev_t *dev);
+const s25fl_profile_t* S25FL_profile(s25fl_dev_t *dev);
+uint32_t S25FL_blankPages(s25fl_dev_t *dev, bool reset);
+uint32_t S25FL_readSfdp(s25fl_dev_t *dev, uint32_t address, uint8_t *buffer, uint32_t len);
+bool S25FL_verify(s25fl_dev_t *dev, uint32_t address, const uint8_t *buffer, uint32_t len);
+s25fl_err_t S25FL_lastError(s25fl_dev_t *dev);
+bool S25FL_idleTask(s25fl_dev_t *dev);
+void S25FL_wakeHint(s25fl_dev_t *dev);
+void S25FL_powerStats(s25fl_dev_t *dev, s25fl_power_stats_t *stats);
 
-bool S25FL_InitDriver(s25fl_t config);
-uint8_t S25FL_readStatus();
-uint32_t S25FL_readDevID();
-void S25FL_writeEnable (bool enable);
-uint32_t S25FL_readBuffer (uint32_t address, uint8_t *buffer, uint32_t len);
-bool S25FL_waitForReady(uint32_t timeout);
-bool S25FL_eraseSector (uint32_t sectorNumber);
-uint32_t S25FL_writeBuffer(uint32_t address, uint8_t *buffer, uint32_t len);
-uint32_t S25FL_writePage (uint32_t address, uint8_t *buffer, uint32_t len, bool fastquit);
-int32_t S25FL_pageSize();
-int8_t S25FL_addressSize();
-int32_t S25FL_numPages();
+#ifdef __cplusplus
+}
+#endif
 
 #endif // _S25FL_H_
@@ -0,0 +1,218 @@
+/*
+ *  S25FL.hpp
+ *
+ *  Created on: 17-09-2021
+ *  Author: Martin Rios - jrios@fi.uba.ar
+ *
+ *  Interfaz C++ del driver, especializada en tiempo de compilacion para un
+ *  puerto y una geometria de memoria. Las cuentas de paginas, sectores y
+ *  bloques son constexpr y la lectura, cuando la memoria esta libre, llama
+ *  directamente a las funciones del puerto, que el compilador puede
+ *  expandir en linea. Todo lo demas (programacion, borrado, SFDP,
+ *  suspension, deep power-down, cache, etc.) se delega en el driver en C,
+ *  que sigue siendo la implementacion de referencia.
+ *
+ *  El puerto es una clase con las funciones estaticas:
+ *
+ *      static s25fl_t config();                        Configuracion para el driver en C
+ *      static void chipSelect(csState_t estado);
+ *      static void setClock(s25fl_clock_t clock);
+ *      static bool transfer(const s25fl_xfer_t *xfer); Como spi_transfer_fnc
+ *
+ *  Ver S25FL_HostPort y S25FL_CiaaPort en los encabezados de los puertos.
+ */
+
+#ifndef _S25FL_HPP_
+#define _S25FL_HPP_
+
+#include <stddef.h>
+#include "S25FL.h"
+
+/**************************************************************************/
+/*!
+    @brief      Geometria de una memoria, fija en tiempo de compilacion.
+
+    @tparam     Capacity    Capacidad en bytes.
+    @tparam     AddrBytes   Bytes de direccion de los comandos (3 o 4).
+*/
+/**************************************************************************/
+template <uint32_t Capacity, uint8_t AddrBytes,
+          uint32_t PageSize = S25FL_PAGESIZE, uint32_t SectorSize = S25FL_SECTORSIZE,
+          uint32_t BlockSize = S25FL_BLOCKSIZE>
+struct S25FL_Geometry
+{
+    static_assert(AddrBytes == 3 || AddrBytes == 4, "La direccion es de 3 o 4 bytes");
+    static_assert(AddrBytes == 4 || Capacity <= (1UL << 24), "Mas de 16 MB requiere direcciones de 4 bytes");
+    static_assert((PageSize & (PageSize - 1)) == 0, "La pagina debe ser potencia de 2");
+    static_assert(SectorSize % PageSize == 0 && BlockSize % SectorSize == 0, "Sector y bloque deben ser multiplos de la pagina");
+    static_assert(Capacity % BlockSize == 0, "La capacidad debe ser multiplo del bloque");
+
+    static constexpr uint32_t capacity = Capacity;
+    static constexpr uint8_t addrBytes = AddrBytes;
+    static constexpr uint32_t pageSize = PageSize;
+    static constexpr uint32_t sectorSize = SectorSize;
+    static constexpr uint32_t blockSize = BlockSize;
+    static constexpr uint32_t pages = Capacity / PageSize;
+    static constexpr uint32_t sectors = Capacity / SectorSize;
+    static constexpr uint32_t blocks = Capacity / BlockSize;
+
+    static constexpr uint32_t page(uint32_t address)            { return address / PageSize; }
+    static constexpr uint32_t pageOffset(uint32_t address)      { return address % PageSize; }
+    static constexpr uint32_t pageRemaining(uint32_t address)   { return PageSize - address % PageSize; }
+    static constexpr uint32_t sector(uint32_t address)          { return address / SectorSize; }
+    static constexpr uint32_t sectorAddress(uint32_t sector)    { return sector * SectorSize; }
+    static constexpr uint32_t block(uint32_t address)           { return address / BlockSize; }
+    static constexpr uint32_t blockAddress(uint32_t block)      { return block * BlockSize; }
+
+    // True si [address, address + len) esta dentro de la memoria
+    static constexpr bool contains(uint32_t address, uint32_t len)
+    {
+        return address < Capacity && len <= Capacity - address;
+    }
+
+    // Comando Fast Read con la cantidad de bytes de direccion de la memoria
+    static constexpr uint8_t fastReadOpcode()
+    {
+        return (AddrBytes == 4) ? S25FL_CMD_FREAD4 : S25FL_CMD_FREAD;
+    }
+};
+
+typedef S25FL_Geometry<8UL << 20, 3>    S25FL064L_Geometry;
+typedef S25FL_Geometry<16UL << 20, 3>   S25FL128L_Geometry;
+typedef S25FL_Geometry<32UL << 20, 4>   S25FL256L_Geometry;
+
+/**************************************************************************/
+/*!
+    @brief      Driver especializado para un puerto y una geometria. Usa el
+                contexto del driver en C, accesible con dev() para el resto
+                de la API.
+*/
+/**************************************************************************/
+template <class Port, class Geometry>
+class S25FL
+{
+public:
+    typedef Geometry geometry;
+
+    /**************************************************************************/
+    /*!
+        @brief      Inicializa el driver en C con la configuracion del puerto.
+
+        @param[in]  config
+                    La configuracion, por defecto la del puerto.
+        @return     False si no se pudo inicializar o si la memoria detectada
+                    no tiene la geometria del template.
+    */
+    /**************************************************************************/
+    bool init(s25fl_t config = Port::config())
+    {
+        if (!S25FL_InitDriver(&dev_, config))   return false;
+
+        return dev_.totalsize == Geometry::capacity &&
+               dev_.pagesize == (int32_t)Geometry::pageSize &&
+               dev_.addrsize == 8 * Geometry::addrBytes &&
+               S25FL_sectorSize(&dev_) == Geometry::sectorSize;
+    }
+
+    /**************************************************************************/
+    /*!
+        @brief      Lee datos de la memoria. Con el modo S25FL_READ_FAST y la
+                    memoria libre (sin operacion en curso, fase de datos
+                    pendiente, lectura continua, cache de lectura ni deep
+                    power-down automatico) la transaccion se arma con
+                    valores constantes y se envia directo al puerto; si no,
+                    o si el puerto no la soporta, se usa S25FL_readBuffer.
+
+        @return     La cantidad de bytes leidos.
+    */
+    /**************************************************************************/
+    uint32_t read(uint32_t address, uint8_t *buffer, uint32_t len)
+    {
+        s25fl_xfer_t xfer;
+        bool done;
+
+        if (!_direct() || address >= Geometry::capacity)    return S25FL_readBuffer(&dev_, address, buffer, len);
+
+        if (len > Geometry::capacity - address)     len = Geometry::capacity - address;
+
+        xfer.opcode = Geometry::fastReadOpcode();
+        xfer.addrBytes = Geometry::addrBytes;
+        xfer.address = address;
+        xfer.modeCycles = 0;
+        xfer.mode = S25FL_MODE_NORMAL;
+        xfer.dummyCycles = S25FL_FREAD_DUMMY_CYCLES;
+        xfer.addrLanes = S25FL_LANES_1;
+        xfer.dataLanes = S25FL_LANES_1;
+        xfer.clock = S25FL_CLK_FAST;
+        xfer.txData = NULL;
+        xfer.rxData = buffer;
+        xfer.len = len;
+        xfer.skipOpcode = false;
+        xfer.wrap = 0;
+
+        if (!dev_.clockValid || dev_.currentClock != S25FL_CLK_FAST)
+        {
+            Port::setClock(S25FL_CLK_FAST);
+            dev_.currentClock = S25FL_CLK_FAST;
+            dev_.clockValid = true;
+        }
+
+        Port::chipSelect(CS_ENABLE);
+        done = Port::transfer(&xfer);
+        Port::chipSelect(CS_DISABLE);
+
+        if (!done)  return S25FL_readBuffer(&dev_, address, buffer, len);
+
+        // El acceso cuenta para S25FL_idleTask como los del driver en C
+        if (dev_.config.time_us_fnc != NULL)    dev_.lastAccess = dev_.config.time_us_fnc();
+        return len;
+    }
+
+    uint32_t write(uint32_t address, uint8_t *buffer, uint32_t len)
+    {
+        return S25FL_writeBuffer(&dev_, address, buffer, len);
+    }
+
+    bool eraseSector(uint32_t sector)
+    {
+        return sector < Geometry::sectors && S25FL_eraseSector(&dev_, sector);
+    }
+
+    bool eraseRange(uint32_t address, uint32_t len)
+    {
+        return S25FL_eraseRange(&dev_, address, len);
+    }
+
+    bool waitForOperation()     { return S25FL_waitForOperation(&dev_); }
+    uint8_t readStatus()        { return S25FL_readStatus(&dev_); }
+    uint32_t readDevID()        { return S25FL_readDevID(&dev_); }
+    bool idleTask()             { return S25FL_idleTask(&dev_); }
+    s25fl_err_t lastError()     { return S25FL_lastError(&dev_); }
+
+    // Contexto del driver en C, para el resto de la API
+    s25fl_dev_t* dev()          { return &dev_; }
+
+private:
+    /**************************************************************************/
+    /*!
+        @return     True si la lectura puede ir directo al puerto: el driver
+                    en C no tiene que esperar, suspender, despertar a la
+                    memoria, salir de la lectura continua ni atender la
+                    lectura desde la cache antes de leer.
+    */
+    /**************************************************************************/
+    bool _direct() const
+    {
+        return dev_.config.read_mode == S25FL_READ_FAST &&
+               !dev_.config.read_cache &&
+               dev_.config.idle_powerdown_us == 0 &&
+               !dev_.busyPending &&
+               dev_.dataPhase == S25FL_DATA_NONE &&
+               dev_.powerState == S25FL_POWER_ACTIVE &&
+               !dev_.continuous;
+    }
+
+    s25fl_dev_t dev_;
+};
+
+#endif // _S25FL_HPP_
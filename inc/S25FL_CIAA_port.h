@@ -13,13 +13,64 @@
 #include "chip.h"
 #include "S25FL.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #define MEMORY_CS           ENET_MDC
+#define MEMORY2_CS          GPIO1           // CS de la segunda memoria, para el disco en dos memorias
+
+// Clock del SSP para cada clase de comando. El SSP redondea hacia abajo
+// al divisor mas cercano que pueda generar.
+#define CIAA_SPI_CLK_CONTROL    10000000    // Estado, habilitacion de escritura y borrado
+#define CIAA_SPI_CLK_READ       50000000    // Lectura normal (0x03), maximo de la memoria
+#define CIAA_SPI_CLK_FAST       108000000   // Fast Read y programacion, maximo de la memoria
+
+#define CIAA_DMA_MAX_CHUNK      4095        // Maximo de transferencias por descriptor del GPDMA
 
 void chipSelect_CIAA_port(csState_t estado);
+void chipSelect2_CIAA_port(csState_t estado);
 bool_t spiRead_CIAA_port(uint8_t* buffer, uint32_t bufferSize);
 uint8_t spiReadRegister_CIAA_port(uint8_t reg);
 void spiWrite_CIAA_port(uint8_t* buffer, uint32_t bufferSize);
 void spiWriteByte_CIAA_port(uint8_t data);
+bool spiTransfer_CIAA_port(const s25fl_xfer_t *xfer);
 void delay_CIAA_port(uint32_t millisecs);
+void spiSetClock_CIAA_port(s25fl_clock_t clock);
+void delayUs_CIAA_port(uint32_t microsecs);
+uint32_t timeUs_CIAA_port();
+void spiDmaInit_CIAA_port();
+bool spiAsync_CIAA_port(uint8_t *txBuffer, uint8_t *rxBuffer, uint32_t len, spiDone_t done, void *ctx);
+
+#ifdef __cplusplus
+}
+
+// Puerto para el driver de S25FL.hpp sobre el SSP1, con la memoria en MEMORY_CS
+struct S25FL_CiaaPort
+{
+    static s25fl_t config()
+    {
+        s25fl_t config = {};
+
+        config.chip_select_ctrl = chipSelect_CIAA_port;
+        config.spi_read_fnc = spiRead_CIAA_port;
+        config.spi_write_fnc = spiWrite_CIAA_port;
+        config.spi_writeByte_fnc = spiWriteByte_CIAA_port;
+        config.spi_read_register = spiReadRegister_CIAA_port;
+        config.delay_fnc = delay_CIAA_port;
+        config.delay_us_fnc = delayUs_CIAA_port;
+        config.time_us_fnc = timeUs_CIAA_port;
+        config.spi_set_clock = spiSetClock_CIAA_port;
+        config.spi_async_fnc = spiAsync_CIAA_port;
+        config.spi_transfer_fnc = spiTransfer_CIAA_port;
+        config.read_mode = S25FL_READ_AUTO;
+        return config;
+    }
+
+    static void chipSelect(csState_t estado)            { chipSelect_CIAA_port(estado); }
+    static void setClock(s25fl_clock_t clock)           { spiSetClock_CIAA_port(clock); }
+    static bool transfer(const s25fl_xfer_t *xfer)      { return spiTransfer_CIAA_port(xfer); }
+};
+#endif
 
 #endif // _S25FL_CIAA_PORT_H_
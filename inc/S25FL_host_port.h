@@ -0,0 +1,128 @@
+/*
+ *  S25FL_host_port.h
+ *
+ *  Created on: 17-09-2021
+ *  Author: Martin Rios - jrios@fi.uba.ar
+ *
+ *  Puerto del driver para compilar en la PC (definir S25FL_HOST_PORT).
+ *  Emula dos memorias S25FL en RAM sobre el mismo bus, con CS separados,
+ *  incluyendo la cantidad de lineas de datos disponibles, para poder
+ *  ejercitar el driver sin el hardware.
+ */
+
+#ifndef _S25FL_HOST_PORT_H_
+#define _S25FL_HOST_PORT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "S25FL.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Fabricante, tipo y capacidad (log2 de los bytes): 0x17 para la S25FL064L,
+// 0x18 para la S25FL128L y 0x19 para la S25FL256L
+#define HOST_JEDEC_ID(size)     (0x016000 | (uint32_t)__builtin_ctz(size))
+
+typedef struct
+{
+    uint64_t busCycles;     // Ciclos de clock SPI consumidos
+    uint32_t commands;      // Cantidad de comandos (flancos de CS)
+    uint32_t laneErrors;    // Transferencias con una cantidad de lineas invalida
+    uint64_t timeNs;        // Tiempo emulado transcurrido
+    uint32_t suspendErrors; // Suspensiones enviadas antes de tRS desde la reanudacion
+    uint32_t asyncTransfers;// Transferencias en segundo plano (DMA emulado)
+    uint32_t portCalls;     // Llamadas al puerto que transfieren datos por el bus
+    uint32_t powerDownErrors;// Comandos ignorados por estar en deep power-down o antes de tRES1
+    uint32_t mapped;        // Regiones entregadas por spiMap_host_port / spiMap2_host_port
+    uint32_t mapInvalidations;// Avisos de modificacion de la vista mapeada
+    uint32_t continuousReads;// Lecturas que empezaron por la direccion, sin el comando
+    uint64_t sspGapNs;      // Tiempo sin clock entre frames de una misma llamada al SSP emulado
+    uint32_t suspendedReads;// Bytes leidos de la region de una operacion suspendida (invalidos)
+    uint32_t sspOverruns;   // Frames perdidos por escribir con el FIFO de transmision lleno o recibir con el de recepcion lleno
+    uint32_t busConflicts;  // Selecciones de una memoria con la otra todavia seleccionada
+    uint32_t programs;      // Programaciones de pagina ejecutadas
+    uint32_t erases;        // Borrados de sector, bloque o de toda la memoria ejecutados
+} host_port_stats_t;
+
+// Falla a inyectar en la proxima programacion o borrado de una memoria
+typedef enum
+{
+    HOST_FAULT_NONE = 0,
+    HOST_FAULT_REPORTED,    // No se modifica la memoria y se activa P_ERR o E_ERR
+    HOST_FAULT_SILENT,      // No se modifica la memoria y no se reporta nada
+} host_fault_t;
+
+bool init_host_port(uint32_t memorySize, s25fl_lanes_t maxLanes);
+void getStats_host_port(host_port_stats_t *stats);
+void resetStats_host_port();
+uint8_t* memory_host_port(uint8_t n);
+void sfdp_host_port(const uint8_t *blob, uint32_t len);
+void fault_host_port(uint8_t n, host_fault_t fault);
+void faultAfter_host_port(uint8_t n, host_fault_t fault, uint32_t skip);
+bool image_host_port(uint8_t n, const char *path);
+
+void chipSelect_host_port(csState_t estado);
+void chipSelect2_host_port(csState_t estado);
+unsigned char spiRead_host_port(uint8_t* buffer, uint32_t bufferSize);
+uint8_t spiReadRegister_host_port(uint8_t reg);
+void spiWrite_host_port(uint8_t* buffer, uint32_t bufferSize);
+void spiWriteByte_host_port(uint8_t data);
+void delay_host_port(uint32_t millisecs);
+void delayUs_host_port(uint32_t microsecs);
+uint32_t timeUs_host_port();
+void spiSetClock_host_port(s25fl_clock_t clock);
+bool spiAsync_host_port(uint8_t *txBuffer, uint8_t *rxBuffer, uint32_t len, spiDone_t done, void *ctx);
+bool spiTransfer_host_port(const s25fl_xfer_t *xfer);
+const uint8_t* spiMap_host_port(uint32_t address, uint32_t len);
+const uint8_t* spiMap2_host_port(uint32_t address, uint32_t len);
+void spiMapInvalidate_host_port(uint32_t address, uint32_t len);
+void spiLanes_host_port(s25fl_lanes_t lanes, uint8_t *txBuffer, uint8_t *rxBuffer, uint32_t len);
+
+// Variantes que pasan por un SSP emulado con sus FIFO, como el de la CIAA
+void sspPrimed_host_port(bool primed);
+unsigned char sspRead_host_port(uint8_t* buffer, uint32_t bufferSize);
+uint8_t sspReadRegister_host_port(uint8_t reg);
+void sspWrite_host_port(uint8_t* buffer, uint32_t bufferSize);
+void sspWriteByte_host_port(uint8_t data);
+bool sspTransfer_host_port(const s25fl_xfer_t *xfer);
+
+#ifdef __cplusplus
+}
+
+// Puerto para el driver de S25FL.hpp sobre la memoria emulada Cs (0 o 1)
+template <uint8_t Cs = 0>
+struct S25FL_HostPort
+{
+    static s25fl_t config()
+    {
+        s25fl_t config = {};
+
+        config.chip_select_ctrl = Cs ? chipSelect2_host_port : chipSelect_host_port;
+        config.spi_read_fnc = spiRead_host_port;
+        config.spi_write_fnc = spiWrite_host_port;
+        config.spi_writeByte_fnc = spiWriteByte_host_port;
+        config.spi_read_register = spiReadRegister_host_port;
+        config.delay_fnc = delay_host_port;
+        config.delay_us_fnc = delayUs_host_port;
+        config.time_us_fnc = timeUs_host_port;
+        config.spi_set_clock = spiSetClock_host_port;
+        config.spi_lanes_fnc = spiLanes_host_port;
+        config.spi_transfer_fnc = spiTransfer_host_port;
+        config.read_mode = S25FL_READ_AUTO;
+        return config;
+    }
+
+    static void chipSelect(csState_t estado)
+    {
+        if (Cs) chipSelect2_host_port(estado);
+        else    chipSelect_host_port(estado);
+    }
+
+    static void setClock(s25fl_clock_t clock)           { spiSetClock_host_port(clock); }
+    static bool transfer(const s25fl_xfer_t *xfer)      { return spiTransfer_host_port(xfer); }
+};
+#endif
+
+#endif // _S25FL_HOST_PORT_H_
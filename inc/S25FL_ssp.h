@@ -0,0 +1,85 @@
+/*
+ *  S25FL_ssp.h
+ *
+ *  Created on: 17-09-2021
+ *  Author: Martin Rios - jrios@fi.uba.ar
+ *
+ *  Nucleo de transferencia por el SSP, compartido por el puerto de la CIAA
+ *  y por el SSP emulado del puerto del host. Antes de incluirlo, el puerto
+ *  define el acceso a los registros de estado y de datos:
+ *
+ *      S25FL_SSP_STATUS()      Lee el registro de estado (SR)
+ *      S25FL_SSP_WRITE(data)   Escribe un frame en el FIFO de transmision (DR)
+ *      S25FL_SSP_READ()        Lee un frame del FIFO de recepcion (DR)
+ */
+
+#ifndef _S25FL_SSP_H_
+#define _S25FL_SSP_H_
+
+#include <stdint.h>
+
+#if !defined(S25FL_SSP_STATUS) || !defined(S25FL_SSP_WRITE) || !defined(S25FL_SSP_READ)
+#error "Definir S25FL_SSP_STATUS, S25FL_SSP_WRITE y S25FL_SSP_READ antes de incluir S25FL_ssp.h"
+#endif
+
+#define S25FL_SSP_FIFO_DEPTH    8           // Frames de los FIFO de transmision y recepcion
+#define S25FL_SSP_STAT_TFE      (1 << 0)    // Bit de SR: FIFO de transmision vacio
+#define S25FL_SSP_STAT_TNF      (1 << 1)    // Bit de SR: FIFO de transmision no lleno
+#define S25FL_SSP_STAT_RNE      (1 << 2)    // Bit de SR: FIFO de recepcion no vacio
+#define S25FL_SSP_STAT_BSY      (1 << 4)    // Bit de SR: transmitiendo o recibiendo un frame
+
+/**************************************************************************/
+/*!
+    @brief      Transfiere un encabezado seguido de una fase de datos
+                manteniendo el FIFO de transmision cargado, para que el SSP
+                no deje de generar clock entre un frame y el siguiente.
+
+    El SSP es full duplex: por cada frame enviado se recibe uno. Se cargan
+    frames mientras haya menos de S25FL_SSP_FIFO_DEPTH en vuelo, de modo
+    que el FIFO de recepcion nunca desborda, y se vacia el de recepcion en
+    rafagas. Los frames recibidos durante el encabezado se descartan.
+
+    @param[in]  header
+                Los bytes del encabezado (comando, direccion, modo y
+                latencia), o NULL si headerLen es 0.
+    @param[in]  headerLen
+                La cantidad de bytes del encabezado.
+    @param[in]  txData
+                Los datos a enviar, o NULL para enviar 0xFF.
+    @param[out] rxData
+                Donde guardar los datos recibidos, o NULL para descartarlos.
+    @param[in]  len
+                La cantidad de bytes de la fase de datos.
+*/
+/**************************************************************************/
+static inline void _sspTransfer(const uint8_t *header, uint32_t headerLen, const uint8_t *txData, uint8_t *rxData, uint32_t len)
+{
+    uint32_t total = headerLen + len, sent = 0, received = 0;
+    uint8_t data;
+
+    // Se descartan los datos que hayan quedado en el FIFO de recepcion
+    while (S25FL_SSP_STATUS() & S25FL_SSP_STAT_RNE)    (void)S25FL_SSP_READ();
+
+    while (received < total)
+    {
+        // Con menos de S25FL_SSP_FIFO_DEPTH frames en vuelo siempre hay
+        // lugar en el FIFO de transmision, por lo que no se consulta TNF
+        while (sent < total && sent - received < S25FL_SSP_FIFO_DEPTH)
+        {
+            if (sent < headerLen)       data = header[sent];
+            else if (txData != NULL)    data = txData[sent - headerLen];
+            else                        data = 0xFF;
+            S25FL_SSP_WRITE(data);
+            sent++;
+        }
+
+        while (S25FL_SSP_STATUS() & S25FL_SSP_STAT_RNE)
+        {
+            data = (uint8_t)S25FL_SSP_READ();
+            if (received >= headerLen && rxData != NULL)   rxData[received - headerLen] = data;
+            received++;
+        }
+    }
+}
+
+#endif // _S25FL_SSP_H_
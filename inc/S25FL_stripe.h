@@ -0,0 +1,37 @@
+/*
+ *  S25FL_stripe.h
+ *
+ *  Created on: 17-09-2021
+ *  Author: Martin Rios - jrios@fi.uba.ar
+ *
+ *  Dispositivo virtual que intercala los sectores entre dos
+ *  memorias S25FL conectadas al mismo bus con CS distintos. Mientras una
+ *  memoria programa o borra, se le envian los datos a la otra.
+ */
+
+#ifndef _S25FL_STRIPE_H_
+#define _S25FL_STRIPE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "S25FL.h"
+
+#define S25FL_STRIPE_CHIPS              2
+
+typedef struct
+{
+    s25fl_dev_t *chips[S25FL_STRIPE_CHIPS];
+    uint8_t count;              // Memorias en uso (1 o 2, 0 si fallo S25FL_stripeInit)
+    uint32_t unit;              // Bytes consecutivos en una misma memoria (un sector)
+    uint32_t totalsize;
+} s25fl_stripe_t;
+
+bool S25FL_stripeInit (s25fl_stripe_t *stripe, s25fl_dev_t *chip0, s25fl_dev_t *chip1);
+uint8_t S25FL_stripeStatus (s25fl_stripe_t *stripe);
+uint32_t S25FL_stripeSize (s25fl_stripe_t *stripe);
+uint32_t S25FL_stripeRead (s25fl_stripe_t *stripe, uint32_t address, uint8_t *buffer, uint32_t len);
+uint32_t S25FL_stripeReadStream (s25fl_stripe_t *stripe, uint32_t address, uint32_t len, s25flStream_t consumer, void *ctx);
+bool S25FL_stripeErase (s25fl_stripe_t *stripe, uint32_t address, uint32_t length);
+uint32_t S25FL_stripeWrite (s25fl_stripe_t *stripe, uint32_t address, uint8_t *buffer, uint32_t len);
+
+#endif // _S25FL_STRIPE_H_
@@ -3,13 +3,13 @@
 
 #include "board.h"      // LPCOpen board support
 #include "diskio.h"		// FatFs lower layer API
+#include "S25FL_stripe.h"
 
 #define FAT_SECTOR_SIZE                     512
-#define FLASH_SECTOR_SIZE                   4096
 
 #define MOUNT_POINT                         ""
 
-bool        S25FL_begin                     (FATFS *_fatFs);
+bool        S25FL_begin                     (FATFS *_fatFs, s25fl_stripe_t *stripe);
 int         S25FL_format                    (FATFS *_fatFs);
 DSTATUS     S25FL_FatFs_DiskStatus          ( void );
 DSTATUS     S25FL_FatFs_DiskInitialize      ( void );
@@ -3,6 +3,9 @@
 
 #define FILE_PATH       "/log.txt"
 
+#define MEMORY_STRIPED  0       // 1: sistema de archivos intercalado en dos memorias (MEMORY_CS y MEMORY2_CS)
+#define MEMORY_IDLE_US  50000   // Tiempo sin accesos antes de poner las memorias en deep power-down
+
 #define OPTIONS_START_Y_POS		6
 #define OPTIONS_START_X_POS		1
 
@@ -37,6 +37,7 @@ uint8_t UART_readOption();
 uint8_t UART_ReadLine(char *lineRead, uint8_t maxLength);
 void UART_WriteLine(const char *line);
 void UART_Write(const char *str);
+void UART_WriteBytes(const uint8_t *data, uint32_t len);
 bool_t UART_Available();
 void UART_ShowOptions(const char **menuOptions, uint8_t lastOptionIndex);
 void UART_clearTerminal();
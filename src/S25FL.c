@@ -8,65 +8,300 @@
 
 #include "S25FL.h"
 #include <stddef.h>
+#include <string.h>
 
-static s25fl_t s25fl;
-
-// Parametros para una memoria de 64 Mbits
-static int32_t pagesize = 256;
-static int8_t addrsize = 24;
-static int32_t pages = 32768;
-static uint32_t totalsize; // 8 MBytes
+// Parametros de cada comando de lectura, indexados por s25fl_read_mode_t
+static const s25fl_read_cmd_t readCommands[S25FL_READ_MODES] =
+{
+    [S25FL_READ_NORMAL]   = { SPIFLASH_SPI_DATAREAD,  S25FL_CMD_READ4,         S25FL_LANES_1, S25FL_LANES_1, 0, 0 },
+    [S25FL_READ_FAST]     = { S25FL_CMD_FREAD,        S25FL_CMD_FREAD4,        S25FL_LANES_1, S25FL_LANES_1, 0, S25FL_FREAD_DUMMY_CYCLES },
+    [S25FL_READ_DUAL_OUT] = { S25FL_CMD_FREADDUALOUT, S25FL_CMD_FREADDUALOUT4, S25FL_LANES_1, S25FL_LANES_2, 0, S25FL_DUALOUT_DUMMY_CYCLES },
+    [S25FL_READ_DUAL_IO]  = { S25FL_CMD_FREADDUALIO,  S25FL_CMD_FREADDUALIO4,  S25FL_LANES_2, S25FL_LANES_2, S25FL_DUALIO_MODE_CYCLES, S25FL_DUALIO_DUMMY_CYCLES },
+    [S25FL_READ_QUAD_OUT] = { S25FL_CMD_FREADQUADOUT, S25FL_CMD_FREADQUADOUT4, S25FL_LANES_1, S25FL_LANES_4, 0, S25FL_QUADOUT_DUMMY_CYCLES },
+    [S25FL_READ_QUAD_IO]  = { S25FL_CMD_FREADQUADIO,  S25FL_CMD_FREADQUADIO4,  S25FL_LANES_4, S25FL_LANES_4, S25FL_QUADIO_MODE_CYCLES, S25FL_QUADIO_DUMMY_CYCLES },
+};
+
+// Tiempos comunes a toda la familia, en microsegundos
+#define S25FL_COMMON_TIMINGS \
+    [S25FL_OP_NONE]         = { 0,                      READY_TIMEOUT * 1000UL }, \
+    [S25FL_OP_PROGRAM]      = { S25FL_TPP_TYP_US,       S25FL_TPP_MAX_US }, \
+    [S25FL_OP_ERASE_4K]     = { S25FL_TSE_TYP_US,       S25FL_TSE_MAX_US }, \
+    [S25FL_OP_ERASE_32K]    = { S25FL_TBE32_TYP_US,     S25FL_TBE32_MAX_US }, \
+    [S25FL_OP_ERASE_64K]    = { S25FL_TBE64_TYP_US,     S25FL_TBE64_MAX_US }, \
+    [S25FL_OP_WRITE_STATUS] = { S25FL_TW_TYP_US,        S25FL_TW_MAX_US }
+
+// Comandos de borrado de toda la familia
+#define S25FL_ERASE_OPCODES \
+    [S25FL_OP_ERASE_4K]     = S25FL_CMD_SECTERASE4, \
+    [S25FL_OP_ERASE_32K]    = S25FL_CMD_BLOCKERASE32, \
+    [S25FL_OP_ERASE_64K]    = S25FL_CMD_BLOCKERASE64, \
+    [S25FL_OP_ERASE_CHIP]   = S25FL_CMD_CHIPERASE
+
+// Perfil de cada modelo, indexado por s25fl_size_t
+static const s25fl_profile_t profiles[] =
+{
+    [S64MB] =
+    {
+        0x016017, 8UL << 20, 256, 4096, 32768, 65536, 3,
+        { S25FL_COMMON_TIMINGS, [S25FL_OP_ERASE_CHIP] = { S25FL_TCE_TYP_US, S25FL_TCE_MAX_US } },
+        { S25FL_ERASE_OPCODES }, readCommands,
+    },
+    [S128MB] =
+    {
+        0x016018, 16UL << 20, 256, 4096, 32768, 65536, 3,
+        { S25FL_COMMON_TIMINGS, [S25FL_OP_ERASE_CHIP] = { S25FL128_TCE_TYP_US, S25FL128_TCE_MAX_US } },
+        { S25FL_ERASE_OPCODES }, readCommands,
+    },
+    [S256MB] =
+    {
+        0x016019, 32UL << 20, 256, 4096, 32768, 65536, 4,
+        { S25FL_COMMON_TIMINGS, [S25FL_OP_ERASE_CHIP] = { S25FL256_TCE_TYP_US, S25FL256_TCE_MAX_US } },
+        { S25FL_ERASE_OPCODES }, readCommands,
+    },
+};
+
+// Unidades de los tiempos tipicos de la tabla SFDP, en microsegundos
+static const uint32_t sfdpEraseUnits[] = { 1000, 16000, 128000, 1000000 };
+static const uint32_t sfdpChipEraseUnits[] = { 16000, 256000, 4000000, 64000000 };
+
+static void _setClock(s25fl_dev_t *dev, s25fl_clock_t clock);
+static uint8_t _readRegister(s25fl_dev_t *dev, uint8_t reg);
+static void _startOperation(s25fl_dev_t *dev, s25fl_op_t op, uint32_t address, uint32_t len);
+static uint32_t _elapsedUs(s25fl_dev_t *dev);
+static void _delayUs(s25fl_dev_t *dev, uint32_t us);
+static bool _eraseCommand(s25fl_dev_t *dev, s25fl_op_t op, uint32_t address);
+static bool _suspend(s25fl_dev_t *dev, bool *suspended);
+static bool _waitOperation(s25fl_dev_t *dev);
+static void _operationDone(s25fl_dev_t *dev);
+static s25fl_err_t _takeError(s25fl_dev_t *dev);
+static bool _fail(s25fl_dev_t *dev, s25fl_err_t error);
+static s25fl_err_t _pollOperation(s25fl_dev_t *dev);
+static s25fl_op_t _eraseStep(const s25fl_profile_t *profile, uint32_t address, uint32_t length, uint32_t *size);
+static void _finishHandle(s25fl_dev_t *dev, s25fl_handle_t *handle, s25fl_err_t error);
+static s25fl_err_t _startHandle(s25fl_dev_t *dev, s25fl_handle_t *handle, s25fl_async_op_t op, uint32_t address, uint8_t *buffer, uint32_t len, s25flCallback_t callback, void *ctx);
+static bool _asyncStart(s25fl_dev_t *dev, uint8_t *txBuffer, uint8_t *rxBuffer, uint32_t len);
+static void _asyncDone(void *ctx);
+static void _asyncWait(s25fl_dev_t *dev);
+static void _completeDataPhase(s25fl_dev_t *dev);
+static void _command(uint8_t opcode, s25fl_xfer_t *xfer);
+static void _transfer(s25fl_dev_t *dev, const s25fl_xfer_t *xfer);
+static void _transferStart(s25fl_dev_t *dev, const s25fl_xfer_t *xfer);
+static void _transferHeader(s25fl_dev_t *dev, const s25fl_xfer_t *xfer);
+static const s25fl_xfer_t* _continuous(s25fl_dev_t *dev, const s25fl_xfer_t *xfer, s25fl_xfer_t *local);
+static void _modeReset(s25fl_dev_t *dev, s25fl_lanes_t lanes);
+static void _burstWrap(s25fl_dev_t *dev, const s25fl_xfer_t *xfer);
+static bool _cacheLookup(s25fl_dev_t *dev, uint32_t address, uint8_t *buffer, uint32_t len);
+static void _cachedRead(s25fl_dev_t *dev, uint32_t address, uint8_t *buffer, uint32_t len);
+static void _cacheFill(s25fl_dev_t *dev, s25fl_cache_line_t *line, uint32_t address, uint8_t *buffer, uint32_t len, bool last);
+static void _cacheStore(s25fl_cache_line_t *line, uint32_t base, uint8_t offset);
+static void _readXfer(s25fl_dev_t *dev, uint32_t address, uint8_t *buffer, uint32_t len, s25fl_xfer_t *xfer);
+static bool _readReady(s25fl_dev_t *dev, uint32_t address, uint32_t len, bool *suspended);
+static void _readTransfer(s25fl_dev_t *dev, uint32_t address, uint8_t *buffer, uint32_t len);
+static void _readData(s25fl_dev_t *dev, s25fl_lanes_t lanes, uint8_t *buffer, uint32_t len);
+static void _sortSegments(s25fl_segment_t *segments, uint32_t count);
+static void _unlinkMap(s25fl_dev_t *dev, s25fl_map_t *map);
+static void _invalidate(s25fl_dev_t *dev, uint32_t address, uint32_t len);
+static bool _programStart(s25fl_dev_t *dev);
+static void _programEnd(s25fl_dev_t *dev);
+static void _resume(s25fl_dev_t *dev);
+static bool _pageValid(s25fl_dev_t *dev, uint32_t address, uint32_t len);
+static bool _blankPage(const uint8_t *buffer, uint32_t len);
+static void _programXfer(s25fl_dev_t *dev, uint32_t address, uint8_t *buffer, uint32_t len, s25fl_xfer_t *xfer);
+static bool _programPage(s25fl_dev_t *dev, const s25fl_xfer_t *xfer);
+static const s25fl_profile_t* _profileById(uint32_t jedecId);
+static bool _discover(s25fl_dev_t *dev);
+static void _sfdpEraseType(s25fl_profile_t *profile, uint8_t sizeExp, uint8_t opcode, uint32_t typical, uint32_t maximum);
+static uint32_t _sfdpMaxTime(uint32_t typical, uint32_t multiplier);
+static uint32_t _bits(uint32_t value, uint8_t lsb, uint8_t width);
+static s25fl_read_mode_t _fastestRead(s25fl_dev_t *dev, s25fl_lanes_t lanes);
+static void _access(s25fl_dev_t *dev);
+static void _wake(s25fl_dev_t *dev);
+static void _powerCommand(s25fl_dev_t *dev, uint8_t opcode);
+static void _powerState(s25fl_dev_t *dev, s25fl_power_state_t state);
+static uint32_t _nowUs(s25fl_dev_t *dev);
 
 /*************************************************************************************************
 	 *  @brief      Inicializacion del driver S25FL
      *
-     *  @details    Se copian los punteros a funciones pasados por argumentos a la estructura interna
-     *              del driver, la cual no puede ser accedida por el resto del programa            
+     *  @details    Se copian los punteros a funciones pasados por argumentos al contexto del
+     *              dispositivo, que luego se pasa a todas las funciones del driver. Cada memoria
+     *              conectada al bus tiene su propio contexto.
      *   	
+	 *  @param		dev		Contexto del dispositivo a inicializar.
 	 *  @param		config	Estructura de configuracion para el driver.
 	 *  @return     True si se inicializo correctamente.
 ***************************************************************************************************/
-bool S25FL_InitDriver(s25fl_t config)
+bool S25FL_InitDriver(s25fl_dev_t *dev, s25fl_t config)
 {
+    uint8_t i;
+
     if(config.chip_select_ctrl != NULL)
-        s25fl.chip_select_ctrl = config.chip_select_ctrl;
+        dev->config.chip_select_ctrl = config.chip_select_ctrl;
     else return false;
 
     if(config.spi_read_fnc != NULL)
-        s25fl.spi_read_fnc = config.spi_read_fnc;
+        dev->config.spi_read_fnc = config.spi_read_fnc;
     else return false;
 
     if(config.spi_write_fnc != NULL)
-        s25fl.spi_write_fnc = config.spi_write_fnc;
+        dev->config.spi_write_fnc = config.spi_write_fnc;
     else return false;
 
     if(config.spi_writeByte_fnc != NULL)
-        s25fl.spi_writeByte_fnc = config.spi_writeByte_fnc;
+        dev->config.spi_writeByte_fnc = config.spi_writeByte_fnc;
     else return false;
 
     if(config.spi_read_register != NULL)
-        s25fl.spi_read_register = config.spi_read_register;
+        dev->config.spi_read_register = config.spi_read_register;
     else return false;
 
     if(config.delay_fnc != NULL)
-        s25fl.delay_fnc = config.delay_fnc;
+        dev->config.delay_fnc = config.delay_fnc;
     else return false;
 
-    switch(s25fl.memory_size)
+    // El cambio de clock es opcional, si no se provee se usa el clock fijo del puerto
+    dev->config.spi_set_clock = config.spi_set_clock;
+    dev->clockValid = false;
+
+    // Se desconoce el estado de la memoria hasta la primera consulta
+    dev->busyPending = true;
+    dev->pendingOp = S25FL_OP_NONE;
+    dev->opLen = 0;
+    dev->welSet = false;
+    dev->opError = S25FL_OK;
+    dev->lastError = S25FL_OK;
+
+    // Las funciones de tiempo en microsegundos son opcionales, sin ellas
+    // la espera se realiza con delay_fnc en milisegundos
+    dev->config.delay_us_fnc = config.delay_us_fnc;
+    dev->config.time_us_fnc = config.time_us_fnc;
+
+    dev->config.suspend_reads = config.suspend_reads;
+
+    if(config.verify > S25FL_VERIFY_READBACK)   return false;
+    dev->config.verify = config.verify;
+    dev->suspendDepth = 0;
+    dev->resumed = false;
+    dev->activeHandle = NULL;
+    dev->dataPhase = S25FL_DATA_NONE;
+    dev->asyncBusy = false;
+
+    dev->config.spi_async_fnc = config.spi_async_fnc;
+    dev->config.spi_transfer_fnc = config.spi_transfer_fnc;
+    dev->config.spi_map_fnc = config.spi_map_fnc;
+    dev->config.spi_map_invalidate_fnc = config.spi_map_invalidate_fnc;
+    dev->maps = NULL;
+
+    // La cache empieza vacia. Si se la usa, la rafaga circular que pudo
+    // quedar configurada antes de un reset se corrige en la primera lectura.
+    dev->config.read_cache = config.read_cache;
+    for (i = 0; i < S25FL_CACHE_LINES; i++)    dev->cache[i].address = S25FL_CACHE_EMPTY;
+    dev->fillLine = NULL;
+    dev->wrap = config.read_cache ? S25FL_WRAP_UNKNOWN : 0;
+    dev->cacheHits = 0;
+    dev->cacheMisses = 0;
+
+    // La memoria puede haber quedado en deep power-down antes de un reset
+    // del microcontrolador, por lo que siempre se la despierta
+    dev->config.idle_powerdown_us = config.idle_powerdown_us;
+    dev->continuous = false;
+
+    // Los modos dual y quad requieren la funcion de transferencia multilinea.
+    // Se la configura antes de enviar el primer comando multilinea.
+    if(config.max_lanes != 0 && config.max_lanes != S25FL_LANES_1 &&
+       config.max_lanes != S25FL_LANES_2 && config.max_lanes != S25FL_LANES_4)  return false;
+    dev->config.spi_lanes_fnc = config.spi_lanes_fnc;
+    dev->config.max_lanes = (config.spi_lanes_fnc != NULL && config.max_lanes != 0) ? config.max_lanes : S25FL_LANES_1;
+
+    _delayUs(dev, S25FL_TDPD_US);
+    _powerCommand(dev, S25FL_CMD_RPWRDDEVID);
+    _delayUs(dev, S25FL_TRES1_US);
+
+    // Tambien puede haber quedado en lectura continua, en la que tomaria
+    // los comandos como direcciones
+    dev->config.continuous_read = config.continuous_read;
+    if (config.continuous_read)
+        _modeReset(dev, dev->config.max_lanes);
+    dev->powerState = S25FL_POWER_ACTIVE;
+    dev->powerSince = dev->lastAccess = _nowUs(dev);
+    memset(&dev->powerStats, 0, sizeof(dev->powerStats));
+    dev->blankPages = 0;
+
+    // La geometria, los tiempos y el ancho de las direcciones salen del
+    // perfil. Primero se usa el del modelo con el JEDEC ID leido o, si no
+    // se lo reconoce, el del memory_size configurado. Luego, si la memoria
+    // tiene la tabla SFDP, se la usa en su lugar.
+    if(config.memory_size > S256MB)    return false;
+    dev->config.memory_size = config.memory_size;
+    dev->profile = &profiles[config.memory_size];
+    if (!_waitOperation(dev))
     {
-        case S64MB:
-             pagesize = 256;
-             addrsize = 24;
-             pages = 32768;
-             totalsize = pages * pagesize;
-            break;
-        
-        case S128MB:
-            break;
-        
-        case S256MB:
-            break;                        
+        const s25fl_profile_t *known = _profileById(S25FL_readDevID(dev));
+
+        if (known != NULL)  dev->profile = known;
+        if (_discover(dev)) dev->profile = &dev->sfdp;
+
+        // Los bits de error quedan fijos hasta un CLSR, por lo que se
+        // borran los que pudo dejar una operacion anterior al reset
+        if (dev->config.verify != S25FL_VERIFY_NONE)
+        {
+            s25fl_xfer_t xfer;
+
+            _command(S25FL_CMD_CLSR, &xfer);
+            _transfer(dev, &xfer);
+        }
+    }
+
+    dev->pagesize = dev->profile->pageSize;
+    dev->addrsize = dev->profile->addrBytes * 8;
+    dev->totalsize = dev->profile->capacity;
+    dev->pages = dev->totalsize / dev->pagesize;
+
+    // Los modos automaticos eligen el mas rapido con las lineas cableadas
+    if(config.read_mode > S25FL_READ_AUTO)   return false;
+    if(config.read_mode == S25FL_READ_AUTO) config.read_mode = _fastestRead(dev, dev->config.max_lanes);
+    if(config.read_mode >= S25FL_READ_DUAL_OUT && config.spi_lanes_fnc == NULL) return false;
+    if(dev->profile->readCmds[config.read_mode].opcode == 0)    return false;
+    dev->config.read_mode = config.read_mode;
+
+    if(config.program_mode > S25FL_PROG_AUTO)   return false;
+    if(config.program_mode == S25FL_PROG_AUTO)
+    {
+        // La programacion quad usa el mismo bit QE que las lecturas quad
+        config.program_mode = (dev->config.max_lanes == S25FL_LANES_4 &&
+                               dev->profile->readCmds[S25FL_READ_QUAD_OUT].opcode != 0) ? S25FL_PROG_QUAD : S25FL_PROG_SINGLE;
+    }
+    if(config.program_mode == S25FL_PROG_QUAD && config.spi_lanes_fnc == NULL)  return false;
+    dev->config.program_mode = config.program_mode;
+
+    // Los modos quad necesitan el bit QE para liberar los pines WP# y HOLD#
+    if(dev->config.read_mode == S25FL_READ_QUAD_OUT || dev->config.read_mode == S25FL_READ_QUAD_IO ||
+       dev->config.program_mode == S25FL_PROG_QUAD)
+    {
+        if(!S25FL_setQuadEnable(dev, true))  return false;
     }
+
+    return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Selecciona el clock SPI adecuado para la clase de comando a
+                enviar, solo si el puerto provee la funcion y el clock
+                actual es distinto.
+
+    @param[in]  clock
+                La clase de comando que se va a enviar.
+*/
+/**************************************************************************/
+static void _setClock(s25fl_dev_t *dev, s25fl_clock_t clock)
+{
+    if (dev->config.spi_set_clock == NULL)    return;
+    if (dev->clockValid && clock == dev->currentClock)    return;
+
+    dev->config.spi_set_clock(clock);
+    dev->currentClock = clock;
+    dev->clockValid = true;
 }
 
 /**************************************************************************/
@@ -79,422 +314,2986 @@ bool S25FL_InitDriver(s25fl_t config)
                 3 - Si esta habilitada la escritura y esta ocupada.
 */
 /**************************************************************************/
-uint8_t S25FL_readStatus()
+uint8_t S25FL_readStatus(s25fl_dev_t *dev)
 {
-    uint8_t status = 0;
-    uint8_t reg;
-    uint8_t rxBuff[1];
-
-    reg = S25FL_CMD_READSTAT1;
-    s25fl.chip_select_ctrl(CS_ENABLE);
-    s25fl.spi_writeByte_fnc(reg);
-    s25fl.spi_read_fnc(rxBuff, 1);
-    s25fl.chip_select_ctrl(CS_DISABLE);
+    uint8_t status = _readRegister(dev, S25FL_CMD_READSTAT1);
 
-    status = rxBuff[0];
     return (status & (SPIFLASH_STAT_BUSY | SPIFLASH_STAT_WRTEN));
 }
 
 /**************************************************************************/
 /*! 
-    @brief      Lee el ID de la memoria guardado en un registro no volatil.
+    @brief      Lee el registro de configuracion 1 de la memoria.
 
-    @return     El ID de 4 bytes del dispositvo.
+    @return     El contenido del registro (ver S25FL_CONFIG_*).
 */
 /**************************************************************************/
-uint32_t S25FL_readDevID()
+uint8_t S25FL_readConfig(s25fl_dev_t *dev)
 {
-    uint32_t devId = 0;
-    uint8_t reg;
-    uint8_t rxBuff[4];
-
-    reg = S25FL_CMD_JEDECID;
-    s25fl.chip_select_ctrl(CS_ENABLE);
-    s25fl.spi_writeByte_fnc(reg);
-    s25fl.spi_read_fnc(rxBuff, 4);
-    s25fl.chip_select_ctrl(CS_DISABLE);
-
-    devId = (((uint32_t)rxBuff[0])<<16) + (((uint32_t)rxBuff[1])<<8) + ((uint32_t)rxBuff[2]);
-    return devId;
+    return _readRegister(dev, S25FL_CMD_READCONFIG);
 }
 
 /**************************************************************************/
 /*! 
-    @brief      Habilita la escritura.
+    @brief      Lee un registro de 1 byte de la memoria.
 
-    @param[in]  enable
-                True habilita, false deshabilita la escritura.
+    @param[in]  reg
+                El comando de lectura del registro.
+    @return     El contenido del registro.
 */
 /**************************************************************************/
-void S25FL_writeEnable (bool enable)
+static uint8_t _readRegister(s25fl_dev_t *dev, uint8_t reg)
 {
-    uint8_t reg;
+    s25fl_xfer_t xfer;
+    uint8_t rxBuff[1];
 
-    reg = enable ? S25FL_CMD_WRITEENABLE : S25FL_CMD_WRITEDISABLE;
+    _command(reg, &xfer);
+    xfer.rxData = rxBuff;
+    xfer.len = 1;
+    _transfer(dev, &xfer);
 
-    s25fl.chip_select_ctrl(CS_ENABLE);
-    s25fl.spi_writeByte_fnc(reg);
-    s25fl.chip_select_ctrl(CS_DISABLE);
+    return rxBuff[0];
 }
 
 /**************************************************************************/
 /*! 
-    @brief      Lee la cantidad de bytes especificada desde la direccion 
-                suministrada.
+    @brief      Habilita o deshabilita el modo quad (bit QE del registro de
+                configuracion 1) mediante el comando Write Status.
 
-    Esta funcion leera uno o mas bytes comenzando desde la direccion
-    suministrada.
+    El registro de estado 1 se vuelve a escribir con su valor actual ya que
+    el comando escribe ambos registros. Si el bit ya tiene el valor pedido
+    no se escribe nada, evitando un ciclo de escritura no volatil.
 
-    @param[in]  address
-                La direccion de 24 bits donde comenzara la lectura.
-    @param[out] *buffer
-                Puntero al buffer donde se guardaran los datos leidos.
-    @param[in]  len
-                Longitud del buffer.
+    @param[in]  enable
+                True habilita, false deshabilita el modo quad.
+    @return     True si el bit QE quedo con el valor pedido.
 */
 /**************************************************************************/
-uint32_t S25FL_readBuffer (uint32_t address, uint8_t *buffer, uint32_t len)
+bool S25FL_setQuadEnable(s25fl_dev_t *dev, bool enable)
 {
-    uint32_t a = 0, i = 0;
-    uint8_t reg, txData[S25FL_MAX_ADDRESS_SIZE];
-
-    // Se chequea que la direccion sea valida
-    if (address >= totalsize)
-    {
-        return 0;
-    }
+    s25fl_xfer_t xfer;
+    uint8_t status, config, txData[2];
 
-    // Se espera a que el dispositivo este listo o que se cumpla el tiempo de espera
-    if (S25FL_waitForReady(READY_TIMEOUT))
-        return 0;
-    
-    s25fl.chip_select_ctrl(CS_ENABLE);
+    if (S25FL_waitForOperation(dev))  return false;
 
-    reg = SPIFLASH_SPI_DATAREAD;
-    s25fl.spi_writeByte_fnc(reg);   // Se envia el comando de lectura
+    status = _readRegister(dev, S25FL_CMD_READSTAT1);
+    config = _readRegister(dev, S25FL_CMD_READCONFIG);
 
-    if (addrsize == 24) // 24 bit addr
-    { 
-        txData[0] = (address >> 16) & 0xFF;     // address upper 8
-        txData[1] = (address >> 8) & 0xFF;      // address mid 8
-        txData[2] = (address) & 0xFF;           // address lower 8
+    if (((config & S25FL_CONFIG_QUAD) != 0) == enable)  return true;
 
-        s25fl.spi_write_fnc(txData, 3);     // Escribimos los 3 bytes de la direccion
-    }
-    else // (addrsize == 16) // Se asume que la direccion es de 16 bit 
-    { 
-        txData[0] = (address >> 8) & 0xFF;      // address high 8
-        txData[1] = (address) & 0xFF;           // address lower 8        
+    if (enable) config |= S25FL_CONFIG_QUAD;
+    else config &= ~S25FL_CONFIG_QUAD;
 
-        s25fl.spi_write_fnc(txData, 2);     // Escribimos los 2 bytes de la direccion
-    }
+    S25FL_writeEnable(dev, true);
+    if (!(S25FL_readStatus(dev) & SPIFLASH_STAT_WRTEN))    return false;
 
-    // En caso de sobrepasar la capacidad maxima de la memoria, se trunca
-    if ((address+len) > totalsize) 
-    {
-        len = totalsize - address;
-    }
+    txData[0] = status & ~(SPIFLASH_STAT_BUSY | SPIFLASH_STAT_WRTEN);
+    txData[1] = config;
 
-    s25fl.spi_read_fnc(buffer, len);    // Se leen los datos del puerto spi
+    _command(S25FL_CMD_WRITESTAT, &xfer);
+    xfer.txData = txData;
+    xfer.len = 2;
+    _transfer(dev, &xfer);
+    _startOperation(dev, S25FL_OP_WRITE_STATUS, 0, 0);
 
-    s25fl.chip_select_ctrl(CS_DISABLE);
+    // La escritura de los registros no volatiles puede demorar cientos de ms
+    if (S25FL_waitForOperation(dev))  return false;
 
-    return len; // Se devuelve la cantidad de bytes leidos
+    return ((_readRegister(dev, S25FL_CMD_READCONFIG) & S25FL_CONFIG_QUAD) != 0) == enable;
 }
 
 /**************************************************************************/
 /*! 
-    @brief      Espera a que la memoria flash indique que esta lista (no ocupada)
-                o hasta que se termine el tiempo de espera.
-
-    @param[in]  timeout
-                El tiempo de espera maximo.
+    @brief      Lee el ID de la memoria guardado en un registro no volatil.
 
-    @return     True si la flash esta lista, false si esta ocupada
+    @return     El ID de 4 bytes del dispositvo.
 */
 /**************************************************************************/
-bool S25FL_waitForReady(uint32_t timeout)
+uint32_t S25FL_readDevID(s25fl_dev_t *dev)
 {
-  uint8_t status;
+    uint32_t devId = 0;
+    s25fl_xfer_t xfer;
+    uint8_t rxBuff[4];
 
-  while ( timeout > 0 )
-  {
-    status = S25FL_readStatus() & SPIFLASH_STAT_BUSY;
-    if (status == 0)
-    {
-      return false;
-    }
-    s25fl.delay_fnc(1);
-    timeout--;
-  }
+    _command(S25FL_CMD_JEDECID, &xfer);
+    xfer.rxData = rxBuff;
+    xfer.len = 4;
+    _transfer(dev, &xfer);
 
-  return true;
+    devId = (((uint32_t)rxBuff[0])<<16) + (((uint32_t)rxBuff[1])<<8) + ((uint32_t)rxBuff[2]);
+    return devId;
 }
 
 /**************************************************************************/
 /*! 
-    @brief      Borra el contenido de un sector de la flash.
+    @brief      Lee la tabla SFDP (Serial Flash Discoverable Parameters) de
+                la memoria.
 
-    @param[in]  sectorNumber
-                El numero de sector a borrar (comienza en cero)
+    @param[in]  address
+                La direccion dentro de la tabla.
+    @param[out] buffer
+                El buffer donde se guardaran los datos leidos.
+    @param[in]  len
+                La cantidad de bytes a leer.
+    @return     La cantidad de bytes leidos.
 */
 /**************************************************************************/
-bool S25FL_eraseSector (uint32_t sectorNumber)
+uint32_t S25FL_readSfdp(s25fl_dev_t *dev, uint32_t address, uint8_t *buffer, uint32_t len)
 {
-    uint8_t reg, txData[S25FL_MAX_ADDRESS_SIZE];
-    
-    // Se chequea que sea un sector valido
-    if (sectorNumber >= S25FL_SECTORS) return false;
-
-    // Se espera hasta que el dispositivo este listo o a que se agote el tiempo de espera
-    if (S25FL_waitForReady(READY_TIMEOUT))    return false;
-
-    // Se habilita la escritura
-    S25FL_writeEnable (true);
-
-    // Se chequea que se haya habilitado la escritura
-    uint8_t status;
-    status = S25FL_readStatus();
-    if (!(status & SPIFLASH_STAT_WRTEN))
-    {
-        return false;
-    }
-
-    uint32_t address = sectorNumber * S25FL_SECTORSIZE;
-    s25fl.chip_select_ctrl(CS_ENABLE);
-    
-    // Se envia el comando para borrar el sector
-    reg = S25FL_CMD_SECTERASE4;
-    s25fl.spi_writeByte_fnc(reg);
-    
-    txData[0] = (address >> 16) & 0xFF;     // address upper 8
-    txData[1] = (address >> 8) & 0xFF;      // address mid 8
-    txData[2] = (address) & 0xFF;           // address lower 8   
-
-    s25fl.spi_write_fnc(txData, 3);     // Escribimos los 3 bytes de la direccion
-
-    s25fl.chip_select_ctrl(CS_DISABLE);
-
-    // Se espera hasta que el dispositivo se desocupe antes de retornar.
-    // Segun la hoja de datos esto puede demorar hasta 400 ms.
-    if (S25FL_waitForReady(500))    return false;
-
-    return true;
+    s25fl_xfer_t xfer;
+
+    _command(S25FL_CMD_READSFDP, &xfer);
+    xfer.addrBytes = 3;
+    xfer.address = address;
+    xfer.dummyCycles = S25FL_SFDP_DUMMY_CYCLES;
+    xfer.clock = S25FL_CLK_READ;
+    xfer.rxData = buffer;
+    xfer.len = len;
+    _transfer(dev, &xfer);
+
+    return len;
 }
 
 /**************************************************************************/
 /*! 
-    @brief      Escribe un flujo de datos continuo que automaticamente
-                puede cruzar de una pagina a otra.      
-                
-    @note       Antes de escribir los datos, asegurarse que los sectores
-                correspondientes han sido borrados, de otro modo, los datos
-                no tendrian sentido.      
-
-    @param[in]  address
-                La direccion de 24 bits donde comenzara la escritura.
-    @param[out] *buffer
-                Puntero al buffer de los datos a escribir.
-    @param[in]  len
-                Longitud del buffer, dentro de los limites de la capacidad
-                de la flash.
+    @return     El perfil del modelo con el JEDEC ID indicado, o NULL si no
+                es un modelo conocido.
 */
 /**************************************************************************/
-uint32_t S25FL_writeBuffer(uint32_t address, uint8_t *buffer, uint32_t len)
+static const s25fl_profile_t* _profileById(uint32_t jedecId)
 {
-    uint32_t bytestowrite;
-    uint32_t bufferoffset;
-    uint32_t results;
-    uint32_t byteswritten;
-
-    // Las validaciones de address y len se realizaran en la funcion de escribir
-    // pagina por lo que no tiene sentido duplicarlas aca.
+    uint8_t i;
 
-    // Si los datos estan solo en una sola pagina, se escribe esa pagina directamente
-    if ((address % pagesize) + len <= pagesize)
-    {
-        return S25FL_writePage(address, buffer, len, false);
-    }
-
-    // Escritura de multiples paginas
-    byteswritten = 0;
-    bufferoffset = 0;
-    while(len)
+    for (i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++)
     {
-        // Se determina la cantidad de bytes necesarios a escribir en esta pagina
-        bytestowrite = pagesize - (address % pagesize);
-        // Se escribe la pagina actual
-        results = S25FL_writePage(address, buffer+bufferoffset, bytestowrite, false);
-        byteswritten += results;
-        
-        // Si ocurrio algun error, se sale devolviendo la cantidad de bytes escritos hasta el momento
-        if (!results)   return byteswritten;
-        
-        // Se ajustan los valores de la direccion, longitud y offset del buffer
-        address += bytestowrite;
-        len -= bytestowrite;
-        bufferoffset+=bytestowrite;
-        
-        // Si es la ultima pagina, se escribe y se sale, si no,
-        // se sigue en el loop con la proxima pagina.
-        if (len <= pagesize)
-        {
-            // Se escriben los ultimos bytes en la pagina y se sale
-            results = S25FL_writePage(address, buffer+bufferoffset, len, false);
-            byteswritten += results;
-
-            // Si ocurrio algun error, se sale devolviendo la cantidad de bytes escritos hasta el momento
-            if (!results)   return byteswritten;
-            
-            len = 0;    // Se setea len en cero para salir del loop
-        }
+        if (profiles[i].jedecId == jedecId)    return &profiles[i];
     }
-
-    // Se devuelve la cantidad de bytes escritos
-    return byteswritten;
+    return NULL;
 }
 
 /**************************************************************************/
 /*! 
-    @brief      Escribe hasta 256 bytes de datos en la pagina especificada.
-                
-    @note       Antes de escribir los datos a la pagina, asegurarse que el
-                sector de 4k que contiene la pagina especifica ha sido
-                borrado, de otro modo, los datos no tendrian sentido.
+    @brief      Arma el perfil de la memoria a partir de la tabla basica de
+                parametros (BFPT) de SFDP: capacidad, ancho de direcciones,
+                tipos de borrado con sus tiempos, pagina, tiempo de
+                programacion y comandos de lectura rapida soportados con sus
+                ciclos de modo y de latencia.
 
-    @param[in]  address
-                La direccion de 24 bits donde comenzara la escritura.
-    @param[in] *buffer
-                Puntero al buffer de los datos a escribir.
-    @param[in]  len
-                Longitud del buffer. El valor debe estar entre 1 y 256.                
-    @param[in]  fastquit
-                Si es true, la funcion retorna sin esperar a que el
-                dispositivo este disponible nuevamente.
+    Los campos que la tabla no trae (revisiones con menos de 16 DWORDs) se
+    conservan del perfil actual. Los comandos con direccion de 4 bytes son
+    los estandar de la familia.
+
+    @return     True si la memoria tiene una tabla SFDP valida.
 */
 /**************************************************************************/
-uint32_t S25FL_writePage (uint32_t address, uint8_t *buffer, uint32_t len, bool fastquit)
+static bool _discover(s25fl_dev_t *dev)
 {
-    uint8_t status;
-    uint8_t reg, txData[S25FL_MAX_ADDRESS_SIZE];
+    s25fl_profile_t *p = &dev->sfdp;
+    uint8_t header[16];
+    uint8_t raw[S25FL_SFDP_BFPT_DWORDS * 4];
+    uint32_t dw[S25FL_SFDP_BFPT_DWORDS] = {0};
+    uint32_t dwords, ptp, i, typical, multiplier;
+    uint64_t bits;
+
+    // Encabezado SFDP y primer encabezado de parametros, que debe ser la BFPT
+    S25FL_readSfdp(dev, 0, header, sizeof(header));
+    if ((header[0] | (header[1] << 8) | (header[2] << 16) | ((uint32_t)header[3] << 24)) != S25FL_SFDP_SIGNATURE)
+        return false;
+    if ((header[8] | (header[15] << 8)) != S25FL_SFDP_BFPT_ID)  return false;
 
-    // Se chequea que la direccion sea valida
-    if (address >= S25FL_MAXADDRESS)
+    dwords = header[11];
+    if (dwords < S25FL_SFDP_BFPT_MIN_DWORDS)  return false;
+    if (dwords > S25FL_SFDP_BFPT_DWORDS)  dwords = S25FL_SFDP_BFPT_DWORDS;
+    ptp = header[12] | (header[13] << 8) | ((uint32_t)header[14] << 16);
+
+    S25FL_readSfdp(dev, ptp, raw, dwords * 4);
+    for (i = 0; i < dwords; i++)
     {
-        return 0;
+        dw[i] = raw[4*i] | (raw[4*i + 1] << 8) | (raw[4*i + 2] << 16) | ((uint32_t)raw[4*i + 3] << 24);
     }
 
-    // Se chequea que la longitud de los datos no supere el tamaño de la pagina
-    if (len > pagesize)
+    // Densidad (DWORD 2), en bits
+    if (dw[1] & 0x80000000)
     {
-        return 0;
+        if ((dw[1] & 0x7FFFFFFF) > 35)    return false;
+        bits = (uint64_t)1 << (dw[1] & 0x7FFFFFFF);
     }
-
-    // Se chequea que los datos no sean escritos mas alla de los limites de la pagina
-    if ((address % pagesize) + len > pagesize)
+    else
     {
-        // Si se trata de escribir en una pagina despues del ultimo byte,
-        // este dato caera al principio de la pagina, mezclandose con lo que
-        // ya habia.
-        return 0;
+        bits = (uint64_t)dw[1] + 1;
     }
+    if (bits < 8 * 65536 || bits > 8 * (uint64_t)UINT32_MAX)  return false;
 
-    // Se espera hasta que el dispositivo este listo o a que se agote el tiempo de espera
-    if (S25FL_waitForReady(READY_TIMEOUT))
-        return 0;
+    *p = *dev->profile;
+    p->capacity = bits / 8;
 
-    // Se habilita la escritura
-    S25FL_writeEnable (true);
+    // Ancho de direcciones (DWORD 1): solo 3, 3 o 4, solo 4 bytes
+    switch (_bits(dw[0], 17, 2))
+    {
+        case 0:     p->addrBytes = 3;   break;
+        case 1:     p->addrBytes = (p->capacity > (16UL << 20)) ? 4 : 3;    break;
+        case 2:     p->addrBytes = 4;   break;
+        default:    return false;
+    }
+    if (p->addrBytes == 3 && p->capacity > (16UL << 20))   return false;
 
-    // Se chequea que se haya habilitado la escritura
-    status = S25FL_readStatus();
-    if (!(status & SPIFLASH_STAT_WRTEN))
+    // Tipos de borrado (DWORDs 8 y 9) y sus tiempos (DWORD 10)
+    p->sectorSize = p->block32Size = p->blockSize = 0;
+    p->eraseOpcodes[S25FL_OP_ERASE_4K] = p->eraseOpcodes[S25FL_OP_ERASE_32K] = p->eraseOpcodes[S25FL_OP_ERASE_64K] = 0;
+    multiplier = _bits(dw[9], 0, 4);
+    for (i = 0; i < 4; i++)
     {
-        return 0;
+        typical = 0;
+        if (dwords >= 10)
+        {
+            typical = (_bits(dw[9], 4 + 7*i, 5) + 1) * sfdpEraseUnits[_bits(dw[9], 9 + 7*i, 2)];
+        }
+        _sfdpEraseType(p, _bits(dw[7 + i/2], 16*(i%2), 8), _bits(dw[7 + i/2], 16*(i%2) + 8, 8),
+                       typical, _sfdpMaxTime(typical, multiplier));
     }
+    if (p->sectorSize == 0)  return false;
 
-    s25fl.delay_fnc(1);     // Delay para que termine de realizar el chequeo del bit de escritura
-    s25fl.chip_select_ctrl(CS_ENABLE);
+    // Pagina, programacion y borrado total (DWORD 11). Una pagina mayor que
+    // S25FL_PAGESIZE no entra en el buffer de s25fl_append_t: se programa de
+    // a S25FL_PAGESIZE bytes, que tampoco cruzan el limite de la pagina real.
+    if (dwords >= 11)
+    {
+        p->pageSize = 1UL << _bits(dw[10], 4, 4);
+        if (p->pageSize > S25FL_PAGESIZE)  p->pageSize = S25FL_PAGESIZE;
+        typical = (_bits(dw[10], 8, 5) + 1) * (_bits(dw[10], 13, 1) ? 64 : 8);
+        p->timings[S25FL_OP_PROGRAM].typical = typical;
+        p->timings[S25FL_OP_PROGRAM].maximum = _sfdpMaxTime(typical, _bits(dw[10], 0, 4));
+        typical = (_bits(dw[10], 24, 5) + 1) * sfdpChipEraseUnits[_bits(dw[10], 29, 2)];
+        p->timings[S25FL_OP_ERASE_CHIP].typical = typical;
+        p->timings[S25FL_OP_ERASE_CHIP].maximum = _sfdpMaxTime(typical, multiplier);
+    }
 
-    if (addrsize == 24) // Se envia el comando de escritura de pagina seguido de la direccion de 24 bits
-    {       
-        reg = S25FL_CMD_PAGEPROG;
-        s25fl.spi_writeByte_fnc(reg);
-        
-        txData[0] = (address >> 16) & 0xFF;     // address upper 8
-        txData[1] = (address >> 8) & 0xFF;      // address mid 8
+    // Lecturas rapidas soportadas (DWORD 1) con sus ciclos (DWORDs 3 y 4).
+    // La lectura normal y la rapida por una linea son obligatorias. Los
+    // ciclos que no forman bytes enteros en las lineas de la direccion, o
+    // que no entran en el encabezado, no se pueden enviar: en ese caso se
+    // conserva el comando de la tabla de la familia.
+    for (i = 0; i < S25FL_READ_MODES; i++)
+    {
+        dev->sfdpReads[i] = readCommands[i];
+    }
+    struct { s25fl_read_mode_t mode; uint8_t support; uint8_t dword; uint8_t lsb; } fastReads[] =
+    {
+        { S25FL_READ_DUAL_OUT, 16, 3, 0 },
+        { S25FL_READ_DUAL_IO,  20, 3, 16 },
+        { S25FL_READ_QUAD_OUT, 22, 2, 16 },
+        { S25FL_READ_QUAD_IO,  21, 2, 0 },
+    };
+    for (i = 0; i < sizeof(fastReads) / sizeof(fastReads[0]); i++)
+    {
+        s25fl_read_cmd_t *cmd = &dev->sfdpReads[fastReads[i].mode];
+        uint32_t params = _bits(dw[fastReads[i].dword], fastReads[i].lsb, 16);
+        uint32_t dummy = _bits(params, 0, 5), mode = _bits(params, 5, 3);
 
-        if (len == pagesize)
+        if (!_bits(dw[0], fastReads[i].support, 1) || _bits(params, 8, 8) == 0)
         {
-            // Si la longitud es igual al tamaño de la pagina, los ultimos 8 bits
-            // deben ser 0 para que esten dentro de los limites de la pagina
-            txData[2] = 0;                      // address lower 8 
+            cmd->opcode = 0;
+            continue;
         }
-        else
+        if ((mode != 0 && mode * cmd->addrLanes != 8) || (dummy * cmd->addrLanes) % 8 != 0 ||
+            (mode != 0) + (dummy * cmd->addrLanes) / 8 > S25FL_MAX_LATENCY_SIZE)
         {
-            txData[2] = (address) & 0xFF;       // address lower 8 
+            continue;
         }
+        cmd->opcode = _bits(params, 8, 8);
+        cmd->dummyCycles = dummy;
+        cmd->modeCycles = mode;
+    }
+    p->readCmds = dev->sfdpReads;
 
-        s25fl.spi_write_fnc(txData, 3);         // Escribimos los 3 bytes de la direccion
-    } 
-    else if (addrsize == 16) // Se envia el comando de escritura de pagina seguido de la direccion de 16 bits
-    {
-        reg = S25FL_CMD_PAGEPROG;
-        s25fl.spi_writeByte_fnc(reg);
-        
-        txData[0] = (address >> 8) & 0xFF;      // address upper 8
-        txData[1] = (address) & 0xFF;           // address lower 8
+    return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Agrega al perfil un tipo de borrado de la tabla SFDP, si es
+                uno de los tamaños que usa el driver.
+
+    @param[in]  sizeExp
+                El tamaño del borrado como potencia de 2 (0 si no se usa).
+    @param[in]  opcode
+                El comando de borrado.
+*/
+/**************************************************************************/
+static void _sfdpEraseType(s25fl_profile_t *profile, uint8_t sizeExp, uint8_t opcode, uint32_t typical, uint32_t maximum)
+{
+    s25fl_op_t op;
 
-        s25fl.spi_write_fnc(txData, 2);         // Escribimos los 2 bytes de la direccion
-    } 
-    else 
+    switch (sizeExp)
     {
-        return 0;
+        case 12:    op = S25FL_OP_ERASE_4K;     profile->sectorSize = 4096;     break;
+        case 15:    op = S25FL_OP_ERASE_32K;    profile->block32Size = 32768;   break;
+        case 16:    op = S25FL_OP_ERASE_64K;    profile->blockSize = 65536;     break;
+        default:
+            return;
     }
 
-    // Se envian los datos
-    s25fl.spi_write_fnc(buffer, len); 
+    profile->eraseOpcodes[op] = opcode;
+    if (typical != 0)
+    {
+        profile->timings[op].typical = typical;
+        profile->timings[op].maximum = maximum;
+    }
+}
 
-    // La escritura ocurre luego de que CS se ponga en alto
-    s25fl.chip_select_ctrl(CS_DISABLE);
+/**************************************************************************/
+/*! 
+    @return     El tiempo maximo segun SFDP: 2 * (multiplicador + 1) veces
+                el tipico, limitado a 32 bits.
+*/
+/**************************************************************************/
+static uint32_t _sfdpMaxTime(uint32_t typical, uint32_t multiplier)
+{
+    uint64_t maximum = (uint64_t)typical * 2 * (multiplier + 1);
 
-    if (! fastquit) {
-        // Se espera hasta que el dispositivo este listo o a que se agote el tiempo de espera
-        if (S25FL_waitForReady(5)) {
-            return 0;
-        }
-    }
+    return (maximum > UINT32_MAX) ? UINT32_MAX : (uint32_t)maximum;
+}
 
-    return(len);
+/**************************************************************************/
+/*! 
+    @return     El campo de width bits de value que comienza en el bit lsb.
+*/
+/**************************************************************************/
+static uint32_t _bits(uint32_t value, uint8_t lsb, uint8_t width)
+{
+    return (value >> lsb) & ((width < 32) ? ((1UL << width) - 1) : 0xFFFFFFFF);
 }
 
 /**************************************************************************/
 /*! 
-    @return     El tamaño de pagina de la flash.
+    @brief      Elige el modo de lectura mas rapido que soportan la memoria
+                y las lineas cableadas. Los modos I/O envian tambien la
+                direccion por varias lineas, por lo que son los de menor
+                encabezado.
+
+    @param[in]  lanes
+                Las lineas de datos cableadas.
+    @return     El modo de lectura elegido.
 */
 /**************************************************************************/
-int32_t S25FL_pageSize()
+static s25fl_read_mode_t _fastestRead(s25fl_dev_t *dev, s25fl_lanes_t lanes)
 {
-    return pagesize;
+    s25fl_read_mode_t mode;
+    const s25fl_read_cmd_t *cmd;
+
+    for (mode = S25FL_READ_QUAD_IO; mode > S25FL_READ_FAST; mode--)
+    {
+        cmd = &dev->profile->readCmds[mode];
+        if (cmd->opcode != 0 && cmd->addrLanes <= lanes && cmd->dataLanes <= lanes)  return mode;
+    }
+    return S25FL_READ_FAST;
 }
 
 /**************************************************************************/
 /*! 
-    @return     La cantidad de bits de las direcciones de memoria.
+    @brief      Habilita la escritura.
+
+    @param[in]  enable
+                True habilita, false deshabilita la escritura.
 */
 /**************************************************************************/
-int8_t S25FL_addressSize()
+void S25FL_writeEnable (s25fl_dev_t *dev, bool enable)
 {
-    return addrsize;
+    s25fl_xfer_t xfer;
+
+    _command(enable ? S25FL_CMD_WRITEENABLE : S25FL_CMD_WRITEDISABLE, &xfer);
+    _transfer(dev, &xfer);
+
+    dev->welSet = enable;
 }
 
 /**************************************************************************/
 /*! 
-    @return     El numero total de paginas de la flash.
+    @brief      Lee la cantidad de bytes especificada desde la direccion 
+                suministrada.
+
+    Esta funcion leera uno o mas bytes comenzando desde la direccion
+    suministrada. Segun el modo de lectura configurado se utiliza el
+    comando de lectura normal (0x03), el Fast Read (0x0B) o alguna de
+    las lecturas dual/quad, que envian la direccion y/o los datos por
+    varias lineas en paralelo.
+
+    Si el driver se inicializo con suspend_reads y hay un borrado o una
+    programacion en curso, la operacion se suspende durante la lectura y
+    se reanuda al terminar, en lugar de esperar a que finalice.
+
+    @param[in]  address
+                La direccion de 24 bits donde comenzara la lectura.
+    @param[out] *buffer
+                Puntero al buffer donde se guardaran los datos leidos.
+    @param[in]  len
+                Longitud del buffer.
 */
 /**************************************************************************/
-int32_t S25FL_numPages()
+uint32_t S25FL_readBuffer (s25fl_dev_t *dev, uint32_t address, uint8_t *buffer, uint32_t len)
 {
-    return pages;
+    bool suspended = false;
+
+    // Se chequea que la direccion sea valida
+    if (address >= dev->totalsize)
+    {
+        _fail(dev, S25FL_ERR_PARAM);
+        return 0;
+    }
+
+    // Las lecturas cortas que estan completas en la cache no usan el bus,
+    // por lo que no esperan ni suspenden la operacion en curso
+    if (dev->config.read_cache && len <= S25FL_CACHE_LINE && _cacheLookup(dev, address, buffer, len))    return len;
+
+    // En caso de sobrepasar la capacidad maxima de la memoria, se trunca
+    if (len > dev->totalsize - address) 
+    {
+        len = dev->totalsize - address;
+    }
+
+    // Si quedo una programacion o borrado en curso, se la suspende para
+    // atender la lectura o se espera a que termine
+    if (!_readReady(dev, address, len, &suspended))   return 0;
+
+    // Las lecturas cortas pasan por la cache, las demas van directo
+    if (dev->config.read_cache && len <= S25FL_CACHE_LINE)
+        _cachedRead(dev, address, buffer, len);
+    else
+        _readTransfer(dev, address, buffer, len);
+
+    // Se reanuda la operacion suspendida, si la hay
+    if (suspended)  _resume(dev);
+
+    return len; // Se devuelve la cantidad de bytes leidos
 }
 
+/**************************************************************************/
+/*! 
+    @brief      Lee varias regiones no contiguas de la memoria con la menor
+                cantidad de comandos de lectura posible.
+
+    Los segmentos se ordenan por direccion y se consulta el estado de la
+    memoria una sola vez. Los segmentos que se superponen, son consecutivos
+    o estan separados por hasta S25FL_READV_GAP bytes por cada linea de
+    datos del modo de lectura se agrupan, mientras
+    el grupo no supere S25FL_READV_SPAN bytes. Cada grupo se lee con un solo
+    comando en un buffer intermedio y se copia a los segmentos: leer y
+    descartar el hueco cuesta menos que enviar otro comando con su direccion
+    y sus ciclos de latencia. Los segmentos que no se agrupan se leen
+    directamente en su buffer.
+
+    @param[in,out] segments
+                Los segmentos a leer. El arreglo queda ordenado por direccion.
+    @param[in]  count
+                La cantidad de segmentos.
+    @return     La cantidad total de bytes leidos, 0 si algun segmento esta
+                fuera de la memoria o se agoto el tiempo de espera.
+*/
+/**************************************************************************/
+uint32_t S25FL_readv (s25fl_dev_t *dev, s25fl_segment_t *segments, uint32_t count)
+{
+    uint8_t span[S25FL_READV_SPAN];
+    uint32_t i, j, first, start, end, segEnd, total = 0, low = dev->totalsize, high = 0;
+    uint32_t gap = S25FL_READV_GAP * dev->profile->readCmds[dev->config.read_mode].dataLanes;
+    bool suspended = false;
+
+    for (i = 0; i < count; i++)
+    {
+        if (segments[i].address >= dev->totalsize || segments[i].len > dev->totalsize - segments[i].address)
+        {
+            _fail(dev, S25FL_ERR_PARAM);
+            return 0;
+        }
+        total += segments[i].len;
+        if (segments[i].address < low)  low = segments[i].address;
+        if (segments[i].address + segments[i].len > high)   high = segments[i].address + segments[i].len;
+    }
+
+    _sortSegments(segments, count);
+
+    if (high > low && !_readReady(dev, low, high - low, &suspended))   return 0;
+
+    for (first = 0; first < count; first = i)
+    {
+        // Se agregan al grupo los segmentos que empiezan cerca de su final.
+        // Un segmento mas largo que el buffer intermedio se lee solo, ya
+        // que el grupo tiene que entrar completo en span
+        start = segments[first].address;
+        end = start + segments[first].len;
+        for (i = first + 1; i < count && end - start <= S25FL_READV_SPAN && segments[i].address <= end + gap; i++)
+        {
+            segEnd = segments[i].address + segments[i].len;
+            if (segEnd > end)
+            {
+                if (segEnd - start > S25FL_READV_SPAN)  break;
+                end = segEnd;
+            }
+        }
+
+        if (i - first == 1)
+        {
+            if (segments[first].len)    _readTransfer(dev, start, segments[first].buffer, segments[first].len);
+            continue;
+        }
+
+        _readTransfer(dev, start, span, end - start);
+        for (j = first; j < i; j++)
+        {
+            memcpy(segments[j].buffer, span + (segments[j].address - start), segments[j].len);
+        }
+    }
+
+    // Se reanuda la operacion suspendida, si la hay
+    if (suspended)  _resume(dev);
+
+    return total;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Lee una region de la memoria con un solo comando de lectura
+                y entrega los datos de a bloques a un consumidor (UART, CRC,
+                compresor), sin necesitar un buffer del tamaño de la region.
+
+    El comando queda abierto (CS habilitado) mientras el consumidor procesa
+    cada bloque, ya que la memoria admite pausar el clock en cualquier
+    momento. Si el puerto provee spi_async_fnc y se lee por una sola linea,
+    el bloque siguiente se lee por DMA mientras el consumidor procesa el
+    actual, por lo que solo se usan dos bloques de S25FL_STREAM_CHUNK bytes.
+
+    @note       El consumidor no debe usar el bus SPI, y si hay una
+                operacion suspendida para la lectura queda suspendida hasta
+                que termine la lectura completa.
+
+    @param[in]  address
+                La direccion donde comenzara la lectura.
+    @param[in]  len
+                La cantidad de bytes a leer. Se trunca al final de la memoria.
+    @param[in]  consumer
+                La funcion que recibe cada bloque. Si devuelve false se
+                termina la lectura.
+    @param[in]  ctx
+                Contexto para el consumidor.
+    @return     La cantidad de bytes entregados al consumidor.
+*/
+/**************************************************************************/
+uint32_t S25FL_readStream (s25fl_dev_t *dev, uint32_t address, uint32_t len, s25flStream_t consumer, void *ctx)
+{
+    uint8_t chunks[2][S25FL_STREAM_CHUNK];
+    s25fl_xfer_t xfer;
+    uint32_t size, next, done = 0;
+    uint8_t cur = 0;
+    bool suspended = false, async, pending;
+
+    if (consumer == NULL || address >= dev->totalsize)
+    {
+        _fail(dev, S25FL_ERR_PARAM);
+        return 0;
+    }
+    if (len > dev->totalsize - address) len = dev->totalsize - address;
+
+    if (!_readReady(dev, address, len, &suspended))   return 0;
+
+    _readXfer(dev, address, NULL, len, &xfer);
+    _transferStart(dev, &xfer);
+    async = (xfer.dataLanes == S25FL_LANES_1 && dev->config.spi_async_fnc != NULL);
+
+    size = (len < S25FL_STREAM_CHUNK) ? len : S25FL_STREAM_CHUNK;
+    _readData(dev, xfer.dataLanes, chunks[cur], size);
+
+    while (size)
+    {
+        done += size;
+        next = len - done;
+        if (next > S25FL_STREAM_CHUNK)  next = S25FL_STREAM_CHUNK;
+
+        // Se lee el bloque siguiente mientras el consumidor procesa el actual
+        pending = (next && async && _asyncStart(dev, NULL, chunks[cur ^ 1], next));
+
+        if (!consumer(chunks[cur], size, ctx))
+        {
+            if (pending)    _asyncWait(dev);
+            break;
+        }
+
+        if (pending)    _asyncWait(dev);
+        else if (next)  _readData(dev, xfer.dataLanes, chunks[cur ^ 1], next);
+
+        cur ^= 1;
+        size = next;
+    }
+
+    dev->config.chip_select_ctrl(CS_DISABLE);
+
+    // Se reanuda la operacion suspendida, si la hay
+    if (suspended)  _resume(dev);
+
+    return done;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Obtiene un puntero de solo lectura a una region de la
+                memoria, para recorrer tablas o indices guardados en la
+                flash sin copiarlos con S25FL_readBuffer.
+
+    Si el puerto provee spi_map_fnc (un controlador mapeado en memoria en
+    el target, o la imagen mapeada con mmap en el host) el puntero apunta
+    directamente a la memoria. Si no, o si el puerto no puede mapear la
+    region, se la lee una vez en el buffer indicado. Antes se espera a que
+    termine cualquier programacion o borrado en curso, y mientras haya
+    ventanas mapeadas la memoria no entra en deep power-down.
+
+    Al programar o borrar una parte de la region la ventana queda marcada
+    como desactualizada (stale) y se llama a spi_map_invalidate_fnc. Para
+    volver a leerla se vuelve a llamar a S25FL_map con la misma ventana.
+
+    @param[in,out] map
+                La ventana a mapear. Debe permanecer valida hasta llamar a
+                S25FL_unmap.
+    @param[in]  address
+                La direccion de comienzo de la region.
+    @param[in]  len
+                El tamaño de la region.
+    @param[in]  buffer
+                Buffer de len bytes para cuando el puerto no puede mapear
+                la region, o NULL si siempre la mapea.
+    @return     El puntero a los datos de la region, o NULL si fallo.
+*/
+/**************************************************************************/
+const uint8_t* S25FL_map (s25fl_dev_t *dev, s25fl_map_t *map, uint32_t address, uint32_t len, uint8_t *buffer)
+{
+    const uint8_t *data = NULL;
+
+    if (map == NULL || len == 0 || address >= dev->totalsize || len > dev->totalsize - address)
+    {
+        _fail(dev, S25FL_ERR_PARAM);
+        return NULL;
+    }
+
+    // Si la ventana ya estaba mapeada se la vuelve a mapear
+    _unlinkMap(dev, map);
+    map->data = NULL;
+
+    // Los accesos a la vista mapeada ocurren despues de retornar, por lo
+    // que no alcanza con suspender la operacion en curso
+    if (_waitOperation(dev))
+    {
+        _fail(dev, S25FL_ERR_TIMEOUT);
+        return NULL;
+    }
+
+    if (dev->config.spi_map_fnc != NULL)
+    {
+        _completeDataPhase(dev);
+        _access(dev);
+        data = dev->config.spi_map_fnc(address, len);
+    }
+
+    if (data == NULL)
+    {
+        if (buffer == NULL)
+        {
+            _fail(dev, S25FL_ERR_PARAM);
+            return NULL;
+        }
+        if (S25FL_readBuffer(dev, address, buffer, len) != len)   return NULL;
+        data = buffer;
+    }
+
+    map->data = data;
+    map->address = address;
+    map->len = len;
+    map->stale = false;
+    map->next = dev->maps;
+    dev->maps = map;
+
+    return data;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Libera una ventana obtenida con S25FL_map. El puntero a sus
+                datos deja de ser valido.
+
+    @param[in]  map
+                La ventana a liberar.
+*/
+/**************************************************************************/
+void S25FL_unmap (s25fl_dev_t *dev, s25fl_map_t *map)
+{
+    if (map == NULL)    return;
+
+    _unlinkMap(dev, map);
+    map->data = NULL;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Quita una ventana de la lista de ventanas mapeadas, si esta.
+*/
+/**************************************************************************/
+static void _unlinkMap(s25fl_dev_t *dev, s25fl_map_t *map)
+{
+    s25fl_map_t **link;
+
+    for (link = &dev->maps; *link != NULL; link = &(*link)->next)
+    {
+        if (*link == map)
+        {
+            *link = map->next;
+            return;
+        }
+    }
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Avisa que se va a programar o borrar una region: las
+                ventanas mapeadas que la incluyen quedan desactualizadas y
+                el puerto descarta lo que tenga en cache.
+
+    @param[in]  address
+                La direccion de comienzo de la region.
+    @param[in]  len
+                El tamaño de la region.
+*/
+/**************************************************************************/
+static void _invalidate(s25fl_dev_t *dev, uint32_t address, uint32_t len)
+{
+    s25fl_map_t *map;
+    uint8_t i;
+
+    // Una linea a medio leer se completa antes de descartarla
+    if (dev->dataPhase == S25FL_DATA_LINE)  _completeDataPhase(dev);
+
+    for (i = 0; i < S25FL_CACHE_LINES; i++)
+    {
+        uint32_t line = dev->cache[i].address;
+
+        if (line != S25FL_CACHE_EMPTY && address < line + S25FL_CACHE_LINE && line < address + len)
+            dev->cache[i].address = S25FL_CACHE_EMPTY;
+    }
+
+    for (map = dev->maps; map != NULL; map = map->next)
+    {
+        if (address < map->address + map->len && map->address < address + len)  map->stale = true;
+    }
+
+    if (dev->config.spi_map_invalidate_fnc != NULL) dev->config.spi_map_invalidate_fnc(address, len);
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Entrega una lectura corta si todas sus lineas (una o dos)
+                estan en la cache, sin usar el bus.
+
+    @return     True si se entrego la lectura, false si falta alguna linea.
+*/
+/**************************************************************************/
+static bool _cacheLookup(s25fl_dev_t *dev, uint32_t address, uint8_t *buffer, uint32_t len)
+{
+    const s25fl_cache_line_t *line[2];
+    uint32_t base = address - address % S25FL_CACHE_LINE;
+    uint32_t last = (address + len - 1) - (address + len - 1) % S25FL_CACHE_LINE;
+    uint32_t n;
+
+    line[0] = &dev->cache[(base / S25FL_CACHE_LINE) % S25FL_CACHE_LINES];
+    line[1] = &dev->cache[(last / S25FL_CACHE_LINE) % S25FL_CACHE_LINES];
+    if (line[0]->address != base || line[1]->address != last)   return false;
+
+    n = (last != base) ? base + S25FL_CACHE_LINE - address : len;
+    memcpy(buffer, line[0]->data + (address - base), n);
+    memcpy(buffer + n, line[1]->data, len - n);
+    dev->cacheHits += (last != base) ? 2 : 1;
+
+    return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Lee a traves de la cache de lectura. Cada linea que falta se
+                lee completa para atender las lecturas cercanas siguientes.
+
+    @param[in]  address
+                La direccion donde comenzara la lectura.
+    @param[out] buffer
+                Donde se guardaran los datos leidos.
+    @param[in]  len
+                La cantidad de bytes a leer.
+*/
+/**************************************************************************/
+static void _cachedRead(s25fl_dev_t *dev, uint32_t address, uint8_t *buffer, uint32_t len)
+{
+    s25fl_cache_line_t *line;
+    uint32_t base, offset, n;
+
+    while (len > 0)
+    {
+        offset = address % S25FL_CACHE_LINE;
+        base = address - offset;
+        n = S25FL_CACHE_LINE - offset;
+        if (n > len)    n = len;
+        line = &dev->cache[(base / S25FL_CACHE_LINE) % S25FL_CACHE_LINES];
+
+        // La linea que se esta terminando de leer se completa antes de usarla
+        if (dev->dataPhase == S25FL_DATA_LINE && dev->fillLine == line) _completeDataPhase(dev);
+
+        if (line->address == base)
+        {
+            memcpy(buffer, line->data + offset, n);
+            dev->cacheHits++;
+        }
+        else
+        {
+            _cacheFill(dev, line, address, buffer, n, n == len);
+            dev->cacheMisses++;
+        }
+
+        address += n;
+        buffer += n;
+        len -= n;
+    }
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Lee una linea de la cache y entrega los bytes pedidos.
+
+    Con la lectura quad I/O se usa una rafaga circular del largo de la
+    linea que empieza en la direccion pedida, por lo que esos bytes llegan
+    primero. Si el puerto arma las transacciones por fases y es la ultima
+    linea de la lectura, se los entrega sin esperar el resto de la linea:
+    queda pendiente como la fase de datos S25FL_DATA_LINE, que se completa
+    antes del proximo uso del bus o de la linea. Con los otros modos de
+    lectura se lee la linea alineada.
+
+    @param[out] line
+                La linea a leer.
+    @param[in]  address
+                La direccion pedida.
+    @param[out] buffer
+                Donde se guardaran los bytes pedidos.
+    @param[in]  len
+                La cantidad de bytes pedidos, sin pasar el final de la linea.
+    @param[in]  last
+                Si no se leen mas lineas a continuacion.
+*/
+/**************************************************************************/
+static void _cacheFill(s25fl_dev_t *dev, s25fl_cache_line_t *line, uint32_t address, uint8_t *buffer, uint32_t len, bool last)
+{
+    s25fl_xfer_t xfer;
+    uint8_t offset = address % S25FL_CACHE_LINE;
+    uint32_t base = address - offset;
+
+    line->address = S25FL_CACHE_EMPTY;
+
+    if (dev->config.read_mode != S25FL_READ_QUAD_IO)
+    {
+        _readTransfer(dev, base, line->data, S25FL_CACHE_LINE);
+        line->address = base;
+        memcpy(buffer, line->data + offset, len);
+        return;
+    }
+
+    _readXfer(dev, address, line->data, S25FL_CACHE_LINE, &xfer);
+    xfer.wrap = S25FL_CACHE_LINE;
+
+    if (dev->config.spi_transfer_fnc != NULL || !last)
+    {
+        _transfer(dev, &xfer);
+        _cacheStore(line, base, offset);
+        memcpy(buffer, line->data + offset, len);
+        return;
+    }
+
+    _transferStart(dev, &xfer);
+    _readData(dev, xfer.dataLanes, line->data, len);
+    memcpy(buffer, line->data, len);
+
+    dev->fillLine = line;
+    dev->fillAddress = base;
+    dev->fillOffset = offset;
+    dev->fillLen = len;
+    dev->dataPhase = S25FL_DATA_LINE;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Acomoda una linea recibida en rafaga circular (desde offset
+                hasta el final y luego desde el comienzo) y la marca como
+                valida.
+
+    @param[in]  base
+                La direccion de la linea.
+    @param[in]  offset
+                Donde empezo la rafaga dentro de la linea.
+*/
+/**************************************************************************/
+static void _cacheStore(s25fl_cache_line_t *line, uint32_t base, uint8_t offset)
+{
+    uint8_t received[S25FL_CACHE_LINE];
+
+    memcpy(received, line->data, S25FL_CACHE_LINE);
+    memcpy(line->data + offset, received, S25FL_CACHE_LINE - offset);
+    memcpy(line->data, received + S25FL_CACHE_LINE - offset, offset);
+    line->address = base;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Prepara la memoria para una lectura: si quedo una
+                programacion o borrado en curso, se la suspende o se espera
+                a que termine. Un error de esa operacion no afecta a la
+                lectura y se reporta en la proxima escritura.
+
+    @param[in]  address
+                El comienzo de la region a leer.
+    @param[in]  len
+                El largo de la region, dentro de la memoria.
+    @param[out] suspended
+                True si se suspendio una operacion y se debe llamar a _resume.
+    @return     False si se agoto el tiempo de espera o si la lectura toca
+                la region de una operacion que ya esta suspendida.
+*/
+/**************************************************************************/
+static bool _readReady(s25fl_dev_t *dev, uint32_t address, uint32_t len, bool *suspended)
+{
+    bool timeout, overlap;
+
+    *suspended = false;
+
+    // Los datos de la region que modifica la operacion en curso no son
+    // validos mientras esta suspendida, por lo que esa lectura la espera
+    _completeDataPhase(dev);
+    overlap = dev->busyPending && address < dev->opAddress + dev->opLen && dev->opAddress < address + len;
+
+    if (overlap && dev->suspendDepth > 0)   return _fail(dev, S25FL_ERR_BUSY);
+
+    if (dev->config.suspend_reads && !overlap)  timeout = !_suspend(dev, suspended);
+    else timeout = _waitOperation(dev);
+
+    if (timeout)    return _fail(dev, S25FL_ERR_TIMEOUT);
+
+    return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Envia un comando de lectura con el modo configurado. Las
+                lecturas grandes por una sola linea se hacen por DMA si el
+                puerto lo soporta, el resto en una sola transaccion.
+
+    @param[in]  address
+                La direccion donde comienza la lectura.
+    @param[out] buffer
+                Donde guardar los datos.
+    @param[in]  len
+                La cantidad de bytes a leer, dentro de la memoria.
+*/
+/**************************************************************************/
+static void _readTransfer(s25fl_dev_t *dev, uint32_t address, uint8_t *buffer, uint32_t len)
+{
+    s25fl_xfer_t xfer;
+
+    _readXfer(dev, address, buffer, len, &xfer);
+
+    if (xfer.dataLanes == S25FL_LANES_1 && dev->config.spi_async_fnc != NULL && len >= S25FL_DMA_MIN_LEN)
+    {
+        _transferStart(dev, &xfer);
+        if (_asyncStart(dev, NULL, buffer, len))  _asyncWait(dev);
+        else dev->config.spi_read_fnc(buffer, len);
+        dev->config.chip_select_ctrl(CS_DISABLE);
+    }
+    else
+    {
+        _transfer(dev, &xfer);
+    }
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Lee datos de un comando de lectura ya enviado con
+                _transferStart, por la cantidad de lineas del comando.
+
+    @param[in]  lanes
+                Las lineas de datos del comando.
+    @param[out] buffer
+                Donde guardar los datos.
+    @param[in]  len
+                La cantidad de bytes a leer.
+*/
+/**************************************************************************/
+static void _readData(s25fl_dev_t *dev, s25fl_lanes_t lanes, uint8_t *buffer, uint32_t len)
+{
+    if (lanes != S25FL_LANES_1)
+        dev->config.spi_lanes_fnc(lanes, NULL, buffer, len);
+    else
+        dev->config.spi_read_fnc(buffer, len);
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Ordena los segmentos por direccion. Se usa insercion ya que
+                las listas son cortas y suelen estar casi ordenadas.
+*/
+/**************************************************************************/
+static void _sortSegments(s25fl_segment_t *segments, uint32_t count)
+{
+    s25fl_segment_t key;
+    uint32_t i, j;
+
+    for (i = 1; i < count; i++)
+    {
+        key = segments[i];
+        for (j = i; j > 0 && segments[j - 1].address > key.address; j--)
+        {
+            segments[j] = segments[j - 1];
+        }
+        segments[j] = key;
+    }
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Arma la transaccion del comando de lectura configurado, con
+                la direccion, los bits de modo y los ciclos de latencia.
+
+    @param[in]  address
+                La direccion donde comenzara la lectura.
+    @param[out] buffer
+                Donde se guardaran los datos leidos.
+    @param[in]  len
+                La cantidad de bytes a leer.
+    @param[out] xfer
+                La transaccion armada.
+*/
+/**************************************************************************/
+static void _readXfer(s25fl_dev_t *dev, uint32_t address, uint8_t *buffer, uint32_t len, s25fl_xfer_t *xfer)
+{
+    const s25fl_read_cmd_t *cmd = &dev->profile->readCmds[dev->config.read_mode];
+
+    _command((dev->profile->addrBytes == 4) ? cmd->opcode4 : cmd->opcode, xfer);
+    xfer->addrBytes = dev->profile->addrBytes;
+    xfer->address = address;
+    xfer->modeCycles = cmd->modeCycles;
+    xfer->mode = (dev->config.continuous_read && cmd->modeCycles) ? S25FL_MODE_CONTINUOUS : S25FL_MODE_NORMAL;
+    xfer->dummyCycles = cmd->dummyCycles;
+    xfer->addrLanes = cmd->addrLanes;
+    xfer->dataLanes = cmd->dataLanes;
+    xfer->clock = (cmd->dummyCycles == 0 && cmd->modeCycles == 0) ? S25FL_CLK_READ : S25FL_CLK_FAST;
+    xfer->rxData = buffer;
+    xfer->len = len;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Inicializa una transaccion de un comando sin direccion ni
+                datos, por una sola linea y con el clock de control.
+
+    @param[in]  opcode
+                El comando a enviar.
+    @param[out] xfer
+                La transaccion a inicializar.
+*/
+/**************************************************************************/
+static void _command(uint8_t opcode, s25fl_xfer_t *xfer)
+{
+    xfer->opcode = opcode;
+    xfer->addrBytes = 0;
+    xfer->address = 0;
+    xfer->modeCycles = 0;
+    xfer->mode = 0;
+    xfer->dummyCycles = 0;
+    xfer->addrLanes = S25FL_LANES_1;
+    xfer->dataLanes = S25FL_LANES_1;
+    xfer->clock = S25FL_CLK_CONTROL;
+    xfer->txData = NULL;
+    xfer->rxData = NULL;
+    xfer->len = 0;
+    xfer->skipOpcode = false;
+    xfer->wrap = 0;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Realiza una transaccion completa. Si el puerto provee
+                spi_transfer_fnc se le pasa en una sola llamada, si no (o si
+                no la soporta) se arma con las funciones de a una fase.
+
+    @param[in]  xfer
+                La transaccion a realizar.
+*/
+/**************************************************************************/
+static void _transfer(s25fl_dev_t *dev, const s25fl_xfer_t *xfer)
+{
+    s25fl_xfer_t local;
+
+    _completeDataPhase(dev);
+    _access(dev);
+    _burstWrap(dev, xfer);
+    xfer = _continuous(dev, xfer, &local);
+
+    if (dev->config.spi_transfer_fnc != NULL)
+    {
+        _setClock(dev, xfer->clock);
+        dev->config.chip_select_ctrl(CS_ENABLE);
+        if (dev->config.spi_transfer_fnc(xfer))
+        {
+            dev->config.chip_select_ctrl(CS_DISABLE);
+            return;
+        }
+        dev->config.chip_select_ctrl(CS_DISABLE);
+    }
+
+    _transferHeader(dev, xfer);
+
+    if (xfer->len > 0)
+    {
+        if (xfer->dataLanes != S25FL_LANES_1)
+            dev->config.spi_lanes_fnc(xfer->dataLanes, xfer->txData, xfer->rxData, xfer->len);
+        else if (xfer->txData != NULL)
+            dev->config.spi_write_fnc(xfer->txData, xfer->len);
+        else
+            dev->config.spi_read_fnc(xfer->rxData, xfer->len);
+    }
+
+    dev->config.chip_select_ctrl(CS_DISABLE);
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Habilita la memoria y envia el comando, la direccion, los
+                bits de modo y los ciclos de latencia de una transaccion.
+                Los datos deben transferirse a continuacion, antes de
+                deshabilitar CS.
+
+    @param[in]  xfer
+                La transaccion a comenzar.
+*/
+/**************************************************************************/
+static void _transferStart(s25fl_dev_t *dev, const s25fl_xfer_t *xfer)
+{
+    s25fl_xfer_t local;
+
+    _completeDataPhase(dev);
+    _access(dev);
+    _burstWrap(dev, xfer);
+    _transferHeader(dev, _continuous(dev, xfer, &local));
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Envia la fase de encabezado de una transaccion, con la
+                lectura continua ya resuelta por _continuous.
+
+    @param[in]  xfer
+                La transaccion a comenzar.
+*/
+/**************************************************************************/
+static void _transferHeader(s25fl_dev_t *dev, const s25fl_xfer_t *xfer)
+{
+    uint8_t txData[S25FL_MAX_ADDRESS_SIZE + S25FL_MAX_LATENCY_SIZE];
+    uint8_t n = 0, i, dummy;
+
+    for (i = xfer->addrBytes; i > 0; i--)
+    {
+        txData[n++] = (xfer->address >> (8 * (i - 1))) & 0xFF;
+    }
+
+    // Los bits de modo y los ciclos de latencia se envian por las mismas
+    // lineas que la direccion, por lo que cada byte ocupa 8/lineas ciclos
+    if (xfer->modeCycles)
+    {
+        txData[n++] = xfer->mode;
+    }
+    dummy = (xfer->dummyCycles * xfer->addrLanes) / 8;
+    for (i = 0; i < dummy; i++)
+    {
+        txData[n++] = 0xFF;
+    }
+
+    _setClock(dev, xfer->clock);
+    dev->config.chip_select_ctrl(CS_ENABLE);
+
+    if (!xfer->skipOpcode)  dev->config.spi_writeByte_fnc(xfer->opcode);
+
+    if (n == 0) return;
+
+    // Se envia la direccion seguida de los bits de modo y de latencia
+    if (xfer->addrLanes == S25FL_LANES_1)
+        dev->config.spi_write_fnc(txData, n);
+    else
+        dev->config.spi_lanes_fnc(xfer->addrLanes, txData, NULL, n);
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Resuelve la lectura continua antes de enviar una transaccion.
+                Si la memoria quedo en lectura continua y la transaccion es
+                otra lectura continua, se la envia sin el comando. Si es
+                cualquier otro comando, antes se sale con un Mode Bit Reset.
+
+    @param[in]  xfer
+                La transaccion a enviar.
+    @param[out] local
+                Donde armar la copia sin comando, si hace falta.
+    @return     La transaccion a enviar.
+*/
+/**************************************************************************/
+static const s25fl_xfer_t* _continuous(s25fl_dev_t *dev, const s25fl_xfer_t *xfer, s25fl_xfer_t *local)
+{
+    bool enter = (xfer->modeCycles != 0 && xfer->mode == S25FL_MODE_CONTINUOUS);
+
+    if (dev->continuous && enter)
+    {
+        *local = *xfer;
+        local->skipOpcode = true;
+        xfer = local;
+    }
+    else if (dev->continuous)
+    {
+        _modeReset(dev, dev->profile->readCmds[dev->config.read_mode].addrLanes);
+    }
+
+    dev->continuous = enter;
+    return xfer;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Envia el Mode Bit Reset: unos en todas las lineas durante la
+                direccion y los bits de modo, para que la memoria salga de
+                la lectura continua y vuelva a esperar un comando. Si no
+                estaba en lectura continua lo toma como un comando sin
+                efecto.
+
+    @param[in]  lanes
+                Las lineas de direccion de la lectura continua.
+*/
+/**************************************************************************/
+static void _modeReset(s25fl_dev_t *dev, s25fl_lanes_t lanes)
+{
+    uint8_t txData[S25FL_MAX_ADDRESS_SIZE + 1];
+
+    memset(txData, S25FL_CMD_MBR, sizeof(txData));
+
+    _setClock(dev, S25FL_CLK_CONTROL);
+    dev->config.chip_select_ctrl(CS_ENABLE);
+    if (lanes == S25FL_LANES_1)
+        dev->config.spi_write_fnc(txData, sizeof(txData));
+    else
+        dev->config.spi_lanes_fnc(lanes, txData, NULL, sizeof(txData));
+    dev->config.chip_select_ctrl(CS_DISABLE);
+
+    dev->continuous = false;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Configura con SBL el largo de la rafaga circular que pide una
+                lectura quad I/O, si es distinto del que tiene la memoria.
+                Solo la lectura quad I/O usa la rafaga circular, por lo que
+                el resto de los modos nunca la cambia.
+
+    @param[in]  xfer
+                La transaccion a enviar.
+*/
+/**************************************************************************/
+static void _burstWrap(s25fl_dev_t *dev, const s25fl_xfer_t *xfer)
+{
+    s25fl_xfer_t sbl;
+    uint8_t data = 0;
+
+    if (xfer->modeCycles == 0 || dev->config.read_mode != S25FL_READ_QUAD_IO || xfer->wrap == dev->wrap)   return;
+
+    // Los largos de 8, 16, 32 y 64 bytes se codifican de 0 a 3
+    if (xfer->wrap == 0)    data = S25FL_WRAP_DISABLE;
+    else while ((8U << data) < xfer->wrap)  data++;
+
+    _command(S25FL_CMD_SBL, &sbl);
+    sbl.txData = &data;
+    sbl.len = 1;
+    dev->wrap = xfer->wrap;
+    _transfer(dev, &sbl);
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Espera a que la memoria flash indique que esta lista (no ocupada)
+                o hasta que se termine el tiempo de espera.
+
+    @param[in]  timeout
+                El tiempo de espera maximo.
+
+    @return     True si la flash esta lista, false si esta ocupada
+*/
+/**************************************************************************/
+bool S25FL_waitForReady(s25fl_dev_t *dev, uint32_t timeout)
+{
+  uint8_t status;
+
+  while ( timeout > 0 )
+  {
+    status = S25FL_readStatus(dev) & SPIFLASH_STAT_BUSY;
+    if (status == 0)
+    {
+      _operationDone(dev);
+      return false;
+    }
+    dev->config.delay_fnc(1);
+    timeout--;
+  }
+
+  return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Espera a que termine la programacion o borrado en curso,
+                segun los tiempos tipico y maximo de la operacion.
+
+    Primero se espera casi el tiempo tipico de la operacion sin consultar
+    a la memoria, y luego se consulta el estado a intervalos cortos hasta
+    que termine o se supere el tiempo maximo. Si el puerto provee las
+    funciones en microsegundos el tiempo se mide en tiempo real, si no se
+    usa delay_fnc con resolucion de 1 ms.
+
+    Si la operacion que termino, o una anterior que nadie espero, reporto
+    un error en el registro de estado 2, se devuelve true y el codigo queda
+    en S25FL_lastError.
+
+    @return     False si la memoria esta lista, true si se agoto el tiempo
+                maximo de la operacion o la memoria reporto un error.
+*/
+/**************************************************************************/
+bool S25FL_waitForOperation(s25fl_dev_t *dev)
+{
+    if (_waitOperation(dev))    return !_fail(dev, S25FL_ERR_TIMEOUT);
+
+    return _takeError(dev) != S25FL_OK;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Espera a que termine la operacion en curso (ver
+                S25FL_waitForOperation) sin reportar su error, que queda
+                pendiente para la proxima escritura. La usan las lecturas.
+
+    @return     True si se agoto el tiempo maximo de la operacion.
+*/
+/**************************************************************************/
+static bool _waitOperation(s25fl_dev_t *dev)
+{
+    const s25fl_timing_t *timing = &dev->profile->timings[dev->pendingOp];
+    uint32_t elapsed, firstWait, interval;
+
+    _completeDataPhase(dev);
+
+    // No hay ninguna operacion en curso
+    if (!dev->busyPending)   return false;
+
+    firstWait = (timing->typical / 100) * S25FL_FIRST_POLL_PCT;
+    interval = timing->typical / S25FL_POLL_DIVIDER;
+    if (interval < S25FL_POLL_MIN_US)   interval = S25FL_POLL_MIN_US;
+
+    elapsed = _elapsedUs(dev);
+    if (elapsed < firstWait)    _delayUs(dev, firstWait - elapsed);
+
+    while (true)
+    {
+        if (!(S25FL_readStatus(dev) & SPIFLASH_STAT_BUSY))
+        {
+            _operationDone(dev);
+            return false;
+        }
+
+        if (_elapsedUs(dev) >= timing->maximum)    return true;
+
+        _delayUs(dev, interval);
+    }
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Registra el fin de la operacion en curso. Si fue una
+                programacion o un borrado, y la politica de verificacion lo
+                pide, se consultan los bits P_ERR y E_ERR del registro de
+                estado 2.
+
+    Los bits de error quedan fijos hasta enviar el Clear Status Register,
+    que ademas borra el bit WEL. El error queda pendiente hasta que lo
+    reporte la proxima espera de una escritura.
+*/
+/**************************************************************************/
+static void _operationDone(s25fl_dev_t *dev)
+{
+    s25fl_op_t op = dev->pendingOp;
+    s25fl_xfer_t xfer;
+    uint8_t status2;
+
+    dev->busyPending = false;
+    dev->pendingOp = S25FL_OP_NONE;
+
+    if (dev->config.verify == S25FL_VERIFY_NONE)    return;
+    if (op == S25FL_OP_NONE || op == S25FL_OP_WRITE_STATUS)  return;
+
+    status2 = _readRegister(dev, S25FL_CMD_READSTAT2);
+    if (!(status2 & (S25FL_STAT2_P_ERR | S25FL_STAT2_E_ERR)))    return;
+
+    _command(S25FL_CMD_CLSR, &xfer);
+    _transfer(dev, &xfer);
+    dev->welSet = false;
+
+    dev->opError = (status2 & S25FL_STAT2_E_ERR) ? S25FL_ERR_ERASE : S25FL_ERR_PROGRAM;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Obtiene y descarta el error pendiente de la ultima operacion
+                terminada, registrandolo como el ultimo error.
+
+    @return     S25FL_OK si la operacion termino sin errores.
+*/
+/**************************************************************************/
+static s25fl_err_t _takeError(s25fl_dev_t *dev)
+{
+    s25fl_err_t error = dev->opError;
+
+    dev->opError = S25FL_OK;
+    if (error != S25FL_OK)  dev->lastError = error;
+
+    return error;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Registra el error de una funcion que fallo.
+
+    @param[in]  error
+                El motivo del fallo.
+    @return     Siempre false, para retornarlo directamente.
+*/
+/**************************************************************************/
+static bool _fail(s25fl_dev_t *dev, s25fl_err_t error)
+{
+    dev->lastError = error;
+    return false;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Suspende la programacion o borrado en curso para poder leer
+                la memoria.
+
+    Si la lectura ocurre mientras ya hay una operacion suspendida solo se
+    incrementa el anidamiento, y la operacion se reanuda al terminar la
+    lectura mas externa. Se respeta el tiempo minimo entre una reanudacion
+    y la siguiente suspension (tRS), necesario para que la operacion avance.
+    El borrado total no se puede suspender, por lo que se espera a que
+    termine.
+
+    @param[out] suspended
+                True si se suspendio una operacion y se debe llamar a _resume.
+    @return     False si se agoto el tiempo de espera.
+*/
+/**************************************************************************/
+static bool _suspend(s25fl_dev_t *dev, bool *suspended)
+{
+    s25fl_xfer_t xfer;
+    uint32_t elapsed;
+
+    *suspended = false;
+
+    _completeDataPhase(dev);
+
+    if (dev->suspendDepth > 0)
+    {
+        dev->suspendDepth++;
+        *suspended = true;
+        return true;
+    }
+
+    if (!dev->busyPending)   return true;
+
+    if (dev->pendingOp == S25FL_OP_NONE || dev->pendingOp == S25FL_OP_ERASE_CHIP ||
+        dev->pendingOp == S25FL_OP_WRITE_STATUS)
+    {
+        return !_waitOperation(dev);
+    }
+
+    // Si la operacion ya termino no hace falta suspenderla
+    if (!(S25FL_readStatus(dev) & SPIFLASH_STAT_BUSY))
+    {
+        _operationDone(dev);
+        return true;
+    }
+
+    // Se respeta el tiempo minimo desde la ultima reanudacion
+    if (dev->config.time_us_fnc == NULL)
+    {
+        _delayUs(dev, S25FL_TRS_MIN_US);
+    }
+    else if (dev->resumed)
+    {
+        elapsed = dev->config.time_us_fnc() - dev->lastResume;
+        if (elapsed < S25FL_TRS_MIN_US) _delayUs(dev, S25FL_TRS_MIN_US - elapsed);
+    }
+
+    _command(S25FL_CMD_ERASESUSPEND, &xfer);
+    _transfer(dev, &xfer);
+    if (dev->config.time_us_fnc != NULL)  dev->suspendStart = dev->config.time_us_fnc();
+
+    // La memoria libera el bit de ocupado luego de la latencia de suspension (tSL)
+    elapsed = 0;
+    while (S25FL_readStatus(dev) & SPIFLASH_STAT_BUSY)
+    {
+        if (elapsed >= S25FL_TSL_MAX_US)    return false;
+        _delayUs(dev, S25FL_POLL_MIN_US);
+        elapsed += S25FL_POLL_MIN_US;
+    }
+
+    // Si no quedo suspendida es porque la operacion termino antes del comando
+    if (!(_readRegister(dev, S25FL_CMD_READSTAT2) & (S25FL_STAT2_PS | S25FL_STAT2_ES)))
+    {
+        _operationDone(dev);
+        return true;
+    }
+
+    dev->suspendDepth = 1;
+    *suspended = true;
+    return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Reanuda la operacion suspendida por _suspend, cuando termina
+                la lectura mas externa. El tiempo que estuvo suspendida no se
+                cuenta para el tiempo maximo de la operacion.
+*/
+/**************************************************************************/
+static void _resume(s25fl_dev_t *dev)
+{
+    s25fl_xfer_t xfer;
+
+    if (dev->suspendDepth == 0 || --dev->suspendDepth > 0)    return;
+
+    _command(S25FL_CMD_ERASERESUME, &xfer);
+    _transfer(dev, &xfer);
+
+    if (dev->config.time_us_fnc != NULL)
+    {
+        dev->lastResume = dev->config.time_us_fnc();
+        dev->opStart += dev->lastResume - dev->suspendStart;
+        dev->resumed = true;
+    }
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Registra el envio de una programacion o borrado. Al terminar
+                la memoria borra el bit WEL.
+
+    @param[in]  op
+                La operacion enviada.
+    @param[in]  address
+                El comienzo de la region que modifica.
+    @param[in]  len
+                El largo de la region (0 si no modifica la memoria).
+*/
+/**************************************************************************/
+static void _startOperation(s25fl_dev_t *dev, s25fl_op_t op, uint32_t address, uint32_t len)
+{
+    dev->busyPending = true;
+    dev->welSet = false;
+    dev->pendingOp = op;
+    dev->opAddress = address;
+    dev->opLen = len;
+    dev->opWaited = 0;
+    if (dev->config.time_us_fnc != NULL)  dev->opStart = dev->config.time_us_fnc();
+}
+
+/**************************************************************************/
+/*! 
+    @return     Los microsegundos transcurridos desde que se envio la
+                operacion en curso.
+*/
+/**************************************************************************/
+static uint32_t _elapsedUs(s25fl_dev_t *dev)
+{
+    if (dev->config.time_us_fnc != NULL)  return dev->config.time_us_fnc() - dev->opStart;
+    return dev->opWaited;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Realiza un delay en microsegundos. Si el puerto no provee
+                delay_us_fnc se redondea hacia arriba a milisegundos.
+*/
+/**************************************************************************/
+static void _delayUs(s25fl_dev_t *dev, uint32_t us)
+{
+    if (dev->config.delay_us_fnc != NULL)
+    {
+        dev->config.delay_us_fnc(us);
+    }
+    else
+    {
+        us = (us + 999) / 1000;
+        dev->config.delay_fnc(us);
+        us *= 1000;
+    }
+    dev->opWaited += us;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Borra el contenido de un sector de la flash.
+
+    @param[in]  sectorNumber
+                El numero de sector a borrar (comienza en cero)
+*/
+/**************************************************************************/
+bool S25FL_eraseSector (s25fl_dev_t *dev, uint32_t sectorNumber)
+{
+    // Se chequea que sea un sector valido
+    if (sectorNumber >= dev->totalsize / dev->profile->sectorSize) return _fail(dev, S25FL_ERR_PARAM);
+
+    if (!_eraseCommand(dev, S25FL_OP_ERASE_4K, sectorNumber * dev->profile->sectorSize))   return false;
+
+    // Se espera hasta que el dispositivo se desocupe antes de retornar.
+    // Segun la hoja de datos esto puede demorar hasta 400 ms.
+    if (S25FL_waitForOperation(dev))    return false;
+
+    if (dev->config.verify == S25FL_VERIFY_READBACK)
+    {
+        return S25FL_verify(dev, sectorNumber * dev->profile->sectorSize, NULL, dev->profile->sectorSize);
+    }
+
+    return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Borra un rango de la flash usando la menor cantidad de
+                comandos de borrado posible.
+
+    En cada paso se usa el mayor borrado que este alineado a la direccion
+    actual y que entre en lo que resta del rango: bloque de 64 KB, bloque
+    de 32 KB o sector de 4 KB. Si el rango es la memoria completa se usa
+    el borrado total. Cada comando se envia apenas termina el anterior y
+    solo se espera al final del rango.
+
+    @param[in]  address
+                La direccion de comienzo, alineada a un sector de 4 KB.
+    @param[in]  length
+                La cantidad de bytes a borrar, multiplo de 4 KB.
+    @return     True si se borro todo el rango.
+*/
+/**************************************************************************/
+bool S25FL_eraseRange (s25fl_dev_t *dev, uint32_t address, uint32_t length)
+{
+    s25fl_op_t op;
+    uint32_t size, start = address, total = length;
+
+    // Se chequea que el rango este alineado a sectores y dentro de la memoria
+    if ((address % dev->profile->sectorSize) || (length % dev->profile->sectorSize))  return _fail(dev, S25FL_ERR_PARAM);
+    if (address >= dev->totalsize || length > dev->totalsize - address)   return _fail(dev, S25FL_ERR_PARAM);
+
+    if (address == 0 && length == dev->totalsize)
+    {
+        if (!_eraseCommand(dev, S25FL_OP_ERASE_CHIP, 0))   return false;
+        length = 0;
+    }
+
+    while (length)
+    {
+        op = _eraseStep(dev->profile, address, length, &size);
+        if (!_eraseCommand(dev, op, address))  return false;
+
+        address += size;
+        length -= size;
+    }
+
+    // Se espera a que termine el ultimo borrado
+    if (S25FL_waitForOperation(dev))    return false;
+
+    if (dev->config.verify == S25FL_VERIFY_READBACK)    return S25FL_verify(dev, start, NULL, total);
+
+    return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Elige el mayor borrado alineado a la direccion que entre en
+                lo que resta del rango.
+
+    @param[in]  address
+                La direccion actual, alineada a un sector de 4 KB.
+    @param[in]  length
+                Los bytes que restan borrar.
+    @param[out] size
+                El tamaño del borrado elegido.
+    @return     El tipo de borrado a utilizar.
+*/
+/**************************************************************************/
+static s25fl_op_t _eraseStep(const s25fl_profile_t *profile, uint32_t address, uint32_t length, uint32_t *size)
+{
+    if (profile->blockSize && !(address % profile->blockSize) && length >= profile->blockSize)
+    {
+        *size = profile->blockSize;
+        return S25FL_OP_ERASE_64K;
+    }
+    if (profile->block32Size && !(address % profile->block32Size) && length >= profile->block32Size)
+    {
+        *size = profile->block32Size;
+        return S25FL_OP_ERASE_32K;
+    }
+    *size = profile->sectorSize;
+    return S25FL_OP_ERASE_4K;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Borra varios sectores consecutivos de la flash.
+
+    @param[in]  firstSector
+                El numero del primer sector a borrar (comienza en cero).
+    @param[in]  count
+                La cantidad de sectores a borrar.
+    @return     True si se borraron todos los sectores.
+*/
+/**************************************************************************/
+bool S25FL_eraseSectors (s25fl_dev_t *dev, uint32_t firstSector, uint32_t count)
+{
+    uint32_t sectors = dev->totalsize / dev->profile->sectorSize;
+
+    if (firstSector >= sectors || count > sectors - firstSector) return _fail(dev, S25FL_ERR_PARAM);
+
+    return S25FL_eraseRange(dev, firstSector * dev->profile->sectorSize, count * dev->profile->sectorSize);
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Envia un comando de borrado sin esperar a que termine. Antes
+                se espera a que termine la operacion anterior, si la hay.
+
+    @param[in]  op
+                El tipo de borrado (S25FL_OP_ERASE_*).
+    @param[in]  address
+                La direccion alineada al tamaño del borrado.
+    @return     True si se envio el comando.
+*/
+/**************************************************************************/
+static bool _eraseCommand(s25fl_dev_t *dev, s25fl_op_t op, uint32_t address)
+{
+    s25fl_xfer_t xfer;
+    uint32_t size;
+    uint8_t reg;
+
+    bool addr4 = (dev->profile->addrBytes == 4);
+
+    // El comando sale del perfil; con direcciones de 4 bytes se usa su variante
+    reg = dev->profile->eraseOpcodes[op];
+    switch (op)
+    {
+        case S25FL_OP_ERASE_4K:     if (addr4) reg = S25FL_CMD_SECTERASE4_4;     size = dev->profile->sectorSize;    break;
+        case S25FL_OP_ERASE_32K:    if (addr4) reg = S25FL_CMD_BLOCKERASE32_4;   size = dev->profile->block32Size;   break;
+        case S25FL_OP_ERASE_64K:    if (addr4) reg = S25FL_CMD_BLOCKERASE64_4;   size = dev->profile->blockSize;     break;
+        case S25FL_OP_ERASE_CHIP:   size = dev->totalsize;  break;
+        default:
+            return _fail(dev, S25FL_ERR_PARAM);
+    }
+    if (reg == 0)   return _fail(dev, S25FL_ERR_PARAM);
+
+    // Se espera hasta que el dispositivo este listo o a que se agote el tiempo de espera
+    if (S25FL_waitForOperation(dev))    return false;
+
+    // Se habilita la escritura
+    S25FL_writeEnable (dev, true);
+
+    // Se chequea que se haya habilitado la escritura
+    if (!(S25FL_readStatus(dev) & SPIFLASH_STAT_WRTEN))
+    {
+        return _fail(dev, S25FL_ERR_WRITE_ENABLE);
+    }
+
+    // Se envia el comando de borrado. El borrado total no lleva direccion
+    _command(reg, &xfer);
+    if (op != S25FL_OP_ERASE_CHIP)
+    {
+        xfer.addrBytes = dev->profile->addrBytes;
+        xfer.address = address;
+    }
+    address = (op == S25FL_OP_ERASE_CHIP) ? 0 : address - address % size;
+    _invalidate(dev, address, size);
+    _transfer(dev, &xfer);
+    _startOperation(dev, op, address, size);
+
+    return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Escribe un flujo de datos continuo que automaticamente
+                puede cruzar de una pagina a otra.      
+                
+    Las paginas se programan en forma encadenada: el comando y la direccion
+    de la pagina siguiente se arman mientras la actual se esta programando,
+    y solo se consulta el estado de la memoria antes de enviarla. Recien
+    al final se espera a que termine la programacion de la ultima pagina.
+    Las paginas enteramente en 0xFF no se envian, ya que programar unos no
+    modifica la memoria.
+
+    @note       Antes de escribir los datos, asegurarse que los sectores
+                correspondientes han sido borrados, de otro modo, los datos
+                no tendrian sentido.      
+
+    @param[in]  address
+                La direccion de 24 bits donde comenzara la escritura.
+    @param[out] *buffer
+                Puntero al buffer de los datos a escribir.
+    @param[in]  len
+                Longitud del buffer, dentro de los limites de la capacidad
+                de la flash.
+    @return     La cantidad de bytes escritos. Si la memoria reporto un
+                error no se cuenta la pagina que fallo ni las siguientes, y
+                si falla la verificacion por relectura se devuelve 0. El
+                motivo queda en S25FL_lastError.
+*/
+/**************************************************************************/
+uint32_t S25FL_writeBuffer(s25fl_dev_t *dev, uint32_t address, uint8_t *buffer, uint32_t len)
+{
+    uint32_t bytestowrite = 0;
+    uint32_t byteswritten = 0;
+    uint32_t committed = 0;     // Bytes anteriores a la ultima pagina programada
+    bool programming = false;
+    uint32_t start = address;
+    s25fl_xfer_t xfer;
+
+    while(len)
+    {
+        // Se determina la cantidad de bytes necesarios a escribir en esta pagina
+        bytestowrite = dev->pagesize - (address % dev->pagesize);
+        if (bytestowrite > len) bytestowrite = len;
+
+        // Se validan los limites y se arma el comando mientras la pagina
+        // anterior todavia se esta programando
+        if (!_pageValid(dev, address, bytestowrite)) break;
+
+        if (_blankPage(buffer, bytestowrite))
+        {
+            dev->blankPages++;
+        }
+        else
+        {
+            _programXfer(dev, address, buffer, bytestowrite, &xfer);
+
+            // Se programa la pagina sin esperar a que termine. Si fallo la
+            // pagina anterior, se sale devolviendo los bytes escritos antes
+            // de ella (las paginas en blanco posteriores tampoco cuentan)
+            if (!_programPage(dev, &xfer))  return programming ? committed : byteswritten;
+            committed = byteswritten;
+            programming = true;
+        }
+
+        byteswritten += bytestowrite;
+        address += bytestowrite;
+        buffer += bytestowrite;
+        len -= bytestowrite;
+    }
+
+    // Se espera a que termine la programacion de la ultima pagina
+    if (S25FL_waitForOperation(dev))
+    {
+        return programming ? committed : byteswritten;
+    }
+
+    if (dev->config.verify == S25FL_VERIFY_READBACK &&
+        !S25FL_verify(dev, start, buffer - byteswritten, byteswritten))
+    {
+        return 0;
+    }
+
+    // Se devuelve la cantidad de bytes escritos
+    return byteswritten;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Escribe hasta 256 bytes de datos en la pagina especificada.
+                Si el driver se inicializo con S25FL_PROG_QUAD se usa el
+                Quad Page Program (0x32), que envia los datos por 4 lineas.
+                
+    @note       Antes de escribir los datos a la pagina, asegurarse que el
+                sector de 4k que contiene la pagina especifica ha sido
+                borrado, de otro modo, los datos no tendrian sentido.
+
+    @param[in]  address
+                La direccion de 24 bits donde comenzara la escritura.
+    @param[in] *buffer
+                Puntero al buffer de los datos a escribir.
+    @param[in]  len
+                Longitud del buffer. El valor debe estar entre 1 y 256.                
+    @param[in]  fastquit
+                Si es true, la funcion retorna sin esperar a que el
+                dispositivo este disponible nuevamente. La proxima operacion
+                del driver consultara el estado antes de enviar su comando,
+                y un error de programacion se reporta en la proxima espera.
+*/
+/**************************************************************************/
+uint32_t S25FL_writePage (s25fl_dev_t *dev, uint32_t address, uint8_t *buffer, uint32_t len, bool fastquit)
+{
+    s25fl_xfer_t xfer;
+
+    if (!_pageValid(dev, address, len))  return 0;
+
+    // Programar una pagina en 0xFF no modifica la memoria
+    if (_blankPage(buffer, len))
+    {
+        dev->blankPages++;
+    }
+    else
+    {
+        _programXfer(dev, address, buffer, len, &xfer);
+        if (!_programPage(dev, &xfer))  return 0;
+    }
+
+    if (! fastquit) {
+        // Se espera hasta que el dispositivo este listo o a que se agote el tiempo de espera
+        if (S25FL_waitForOperation(dev)) {
+            return 0;
+        }
+
+        if (dev->config.verify == S25FL_VERIFY_READBACK && !S25FL_verify(dev, address, buffer, len)) {
+            return 0;
+        }
+    }
+
+    return(len);
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Prepara un acumulador para agregar registros pequeños a
+                partir de una direccion ya borrada, por ejemplo el final de
+                un log.
+
+    Los datos agregados con S25FL_append se juntan en RAM y se programan de
+    a paginas completas, en lugar de pagar el comando, la habilitacion de
+    escritura y la espera de la programacion por cada registro. Una pagina
+    incompleta se programa con S25FL_appendFlush o cuando sus datos
+    superan deadlineUs en RAM, al agregar mas datos o al llamar a
+    S25FL_appendPoll. El resto de esa pagina sigue en 0xFF y se programa
+    despues con los registros siguientes.
+
+    @param[out] app
+                El acumulador a preparar.
+    @param[in]  address
+                La direccion donde se agregara el primer byte.
+    @param[in]  deadlineUs
+                El tiempo maximo que un byte espera en RAM antes de
+                programarse, o 0 para programar solo las paginas completas
+                y con S25FL_appendFlush. Requiere time_us_fnc.
+*/
+/**************************************************************************/
+void S25FL_appendInit (s25fl_dev_t *dev, s25fl_append_t *app, uint32_t address, uint32_t deadlineUs)
+{
+    (void)dev;
+
+    app->address = address;
+    app->deadlineUs = deadlineUs;
+    app->start = address;
+    app->len = 0;
+    app->since = 0;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Agrega datos a continuacion de los anteriores. Cada pagina
+                se programa al completarse, sin esperar a que la memoria
+                termine: la programacion avanza mientras se acumula la
+                pagina siguiente.
+
+    @note       Los datos que siguen en RAM no se ven con S25FL_readBuffer
+                hasta que se programan.
+
+    @param[in,out] app
+                El acumulador.
+    @param[in]  data
+                Los datos a agregar.
+    @param[in]  len
+                La cantidad de bytes a agregar.
+    @return     La cantidad de bytes agregados. Es menor que len si se llego
+                al final de la memoria o fallo la programacion de una
+                pagina, cuyos datos se descartan (ver S25FL_lastError).
+                Como no se espera a que termine cada pagina, la falla de
+                una se reporta al programar la siguiente.
+*/
+/**************************************************************************/
+uint32_t S25FL_append (s25fl_dev_t *dev, s25fl_append_t *app, const uint8_t *data, uint32_t len)
+{
+    uint32_t done = 0, n, pageBytes = 0;
+
+    // Los datos que ya superaron el plazo se programan antes de agregar
+    if (!S25FL_appendPoll(dev, app))    return 0;
+
+    while (len > 0)
+    {
+        if (app->address >= dev->totalsize)
+        {
+            _fail(dev, S25FL_ERR_PARAM);
+            break;
+        }
+
+        if (app->len == 0)
+        {
+            app->start = app->address;
+            app->since = _nowUs(dev);
+            pageBytes = 0;
+        }
+
+        // Se acumula hasta el final de la pagina
+        n = dev->pagesize - (app->address % dev->pagesize);
+        if (n > len)    n = len;
+        memcpy(app->data + app->len, data, n);
+        app->len += n;
+        app->address += n;
+        pageBytes += n;
+        done += n;
+        data += n;
+        len -= n;
+
+        if (app->address % dev->pagesize == 0 && !S25FL_appendFlush(dev, app))
+        {
+            done -= pageBytes;
+            break;
+        }
+    }
+
+    return done;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Programa los datos acumulados, aunque no completen la
+                pagina. No espera a que la memoria termine salvo con
+                S25FL_VERIFY_READBACK, que relee la pagina.
+
+    @param[in,out] app
+                El acumulador.
+    @return     False si fallo la programacion, en cuyo caso los datos
+                acumulados se descartan.
+*/
+/**************************************************************************/
+bool S25FL_appendFlush (s25fl_dev_t *dev, s25fl_append_t *app)
+{
+    uint32_t len = app->len;
+
+    if (len == 0)   return true;
+
+    app->len = 0;
+    return S25FL_writePage(dev, app->start, app->data, len, dev->config.verify != S25FL_VERIFY_READBACK) == len;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Programa los datos acumulados si superaron el plazo del
+                acumulador. Se debe llamar periodicamente (por ejemplo junto
+                con S25FL_idleTask) para acotar el tiempo que los datos
+                esperan en RAM cuando dejan de llegar registros.
+
+    @param[in,out] app
+                El acumulador.
+    @return     False si fallo la programacion.
+*/
+/**************************************************************************/
+bool S25FL_appendPoll (s25fl_dev_t *dev, s25fl_append_t *app)
+{
+    if (app->len == 0 || app->deadlineUs == 0 || dev->config.time_us_fnc == NULL)  return true;
+    if (_nowUs(dev) - app->since < app->deadlineUs)    return true;
+
+    return S25FL_appendFlush(dev, app);
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Relee una region de la memoria y la compara con los datos
+                esperados, de a S25FL_VERIFY_CHUNK bytes.
+
+    Es la verificacion que usan las escrituras y borrados con la politica
+    S25FL_VERIFY_READBACK, y puede llamarse directamente con cualquier otra.
+
+    @param[in]  address
+                La direccion de comienzo.
+    @param[in]  buffer
+                Los datos esperados, o NULL para verificar que la region
+                este borrada (0xFF).
+    @param[in]  len
+                La cantidad de bytes a comparar.
+    @return     True si la region coincide. Si no, el motivo queda en
+                S25FL_lastError.
+*/
+/**************************************************************************/
+bool S25FL_verify(s25fl_dev_t *dev, uint32_t address, const uint8_t *buffer, uint32_t len)
+{
+    uint8_t chunk[S25FL_VERIFY_CHUNK];
+    uint32_t size, i;
+
+    if (address >= dev->totalsize || len > dev->totalsize - address)  return _fail(dev, S25FL_ERR_PARAM);
+
+    while (len)
+    {
+        size = (len < sizeof(chunk)) ? len : sizeof(chunk);
+        if (S25FL_readBuffer(dev, address, chunk, size) != size)  return false;
+
+        if (buffer != NULL)
+        {
+            if (memcmp(chunk, buffer, size) != 0)   return _fail(dev, S25FL_ERR_VERIFY);
+            buffer += size;
+        }
+        else
+        {
+            for (i = 0; i < size; i++)
+            {
+                if (chunk[i] != 0xFF)   return _fail(dev, S25FL_ERR_VERIFY);
+            }
+        }
+
+        address += size;
+        len -= size;
+    }
+
+    return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Obtiene el motivo del ultimo fallo de una funcion del
+                driver. Solo es valido luego de que una funcion indique que
+                fallo, ya que las operaciones exitosas no lo borran.
+
+    @return     El ultimo error registrado, S25FL_OK si no hubo ninguno.
+*/
+/**************************************************************************/
+s25fl_err_t S25FL_lastError(s25fl_dev_t *dev)
+{
+    return dev->lastError;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Verifica que los datos a programar esten dentro de la memoria
+                y de los limites de una pagina.
+
+    @param[in]  address
+                La direccion donde comenzara la escritura.
+    @param[in]  len
+                La cantidad de bytes a escribir.
+    @return     True si la escritura es valida.
+*/
+/**************************************************************************/
+static bool _pageValid(s25fl_dev_t *dev, uint32_t address, uint32_t len)
+{
+    uint32_t pagesize = (uint32_t)dev->pagesize;
+
+    // Se chequea que la direccion sea valida
+    if (address >= dev->totalsize)    return _fail(dev, S25FL_ERR_PARAM);
+
+    // Se chequea que la longitud de los datos no supere el tamaño de la pagina
+    if (len == 0 || len > pagesize) return _fail(dev, S25FL_ERR_PARAM);
+
+    // Se chequea que los datos no sean escritos mas alla de los limites de la pagina.
+    // Si se trata de escribir en una pagina despues del ultimo byte, este dato
+    // caera al principio de la pagina, mezclandose con lo que ya habia.
+    if ((address % pagesize) + len > pagesize)  return _fail(dev, S25FL_ERR_PARAM);
+
+    return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Verifica si los datos a programar estan enteramente en 0xFF,
+                recorriendolos de a palabras de 32 bits.
+
+    @param[in]  buffer
+                Los datos a programar.
+    @param[in]  len
+                La cantidad de bytes.
+    @return     True si todos los bytes valen 0xFF.
+*/
+/**************************************************************************/
+static bool _blankPage(const uint8_t *buffer, uint32_t len)
+{
+    const uint32_t *word;
+
+    // Bytes hasta la primera palabra alineada
+    while (len && ((uintptr_t)buffer & 3))
+    {
+        if (*buffer++ != 0xFF)  return false;
+        len--;
+    }
+
+    for (word = (const uint32_t*)buffer; len >= 4; len -= 4)
+    {
+        if (*word++ != 0xFFFFFFFFUL)    return false;
+    }
+
+    buffer = (const uint8_t*)word;
+    while (len--)
+    {
+        if (*buffer++ != 0xFF)  return false;
+    }
+
+    return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Arma la transaccion de programacion de una pagina.
+
+    @param[in]  address
+                La direccion donde comenzara la escritura.
+    @param[in]  buffer
+                Los datos a programar.
+    @param[in]  len
+                La cantidad de bytes a programar.
+    @param[out] xfer
+                La transaccion armada.
+*/
+/**************************************************************************/
+static void _programXfer(s25fl_dev_t *dev, uint32_t address, uint8_t *buffer, uint32_t len, s25fl_xfer_t *xfer)
+{
+    // El comando y la direccion siempre van por una sola linea, solo los
+    // datos del Quad Page Program usan las 4 lineas
+    bool addr4 = (dev->profile->addrBytes == 4);
+
+    if (dev->config.program_mode == S25FL_PROG_QUAD)
+    {
+        _command(addr4 ? S25FL_CMD_QUADPAGEPROG4 : S25FL_CMD_QUADPAGEPROG, xfer);
+        xfer->dataLanes = S25FL_LANES_4;
+    }
+    else
+    {
+        _command(addr4 ? S25FL_CMD_PAGEPROG4 : S25FL_CMD_PAGEPROG, xfer);
+    }
+
+    xfer->addrBytes = dev->profile->addrBytes;
+    xfer->address = address;
+    xfer->clock = S25FL_CLK_FAST;   // La programacion de paginas admite el clock maximo
+    xfer->txData = buffer;
+    xfer->len = len;
+
+    _invalidate(dev, address, len);
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Envia una programacion de pagina ya armada, sin esperar a
+                que la memoria termine de programar.
+
+    Solo se consulta el estado si quedo una operacion en curso, y no se
+    relee el registro de estado luego de habilitar la escritura ya que
+    el driver lleva la cuenta del bit WEL.
+
+    @param[in]  xfer
+                La transaccion de programacion (ver _programXfer).
+    @return     True si se envio el comando.
+*/
+/**************************************************************************/
+static bool _programPage(s25fl_dev_t *dev, const s25fl_xfer_t *xfer)
+{
+    if (!_programStart(dev))  return false;
+
+    _transfer(dev, xfer);
+    _startOperation(dev, S25FL_OP_PROGRAM, xfer->address, xfer->len);
+
+    return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Prepara la memoria para programar una pagina: espera a que
+                termine la operacion anterior y habilita la escritura.
+
+    @return     False si se agoto el tiempo de espera de la operacion anterior
+                o si esta reporto un error.
+*/
+/**************************************************************************/
+static bool _programStart(s25fl_dev_t *dev)
+{
+    // Se espera a que termine la operacion anterior, si la hay
+    if (S25FL_waitForOperation(dev))   return false;
+
+    if (!dev->welSet)    S25FL_writeEnable(dev, true);
+
+    return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Termina el envio de una pagina. La escritura ocurre luego de
+                que CS se ponga en alto, y al terminar la memoria borra el
+                bit WEL.
+*/
+/**************************************************************************/
+static void _programEnd(s25fl_dev_t *dev)
+{
+    dev->config.chip_select_ctrl(CS_DISABLE);
+    _startOperation(dev, S25FL_OP_PROGRAM, dev->opAddress, dev->opLen);
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Comienza un borrado no bloqueante de un rango de la flash.
+
+    Se envia el primer comando de borrado y se retorna inmediatamente. Los
+    siguientes se envian desde S25FL_poll a medida que la memoria termina
+    el anterior, eligiendo los borrados igual que S25FL_eraseRange (dev, salvo
+    el borrado total, que no se usa).
+
+    @param[in]  handle
+                La operacion a iniciar. Debe permanecer valida hasta que
+                termine.
+    @param[in]  address
+                La direccion de comienzo, alineada a un sector de 4 KB.
+    @param[in]  length
+                La cantidad de bytes a borrar, multiplo de 4 KB.
+    @param[in]  callback
+                Funcion a llamar al terminar (opcional).
+    @param[in]  ctx
+                Contexto para la funcion.
+    @return     S25FL_OK si se inicio la operacion.
+*/
+/**************************************************************************/
+s25fl_err_t S25FL_startErase (s25fl_dev_t *dev, s25fl_handle_t *handle, uint32_t address, uint32_t length, s25flCallback_t callback, void *ctx)
+{
+    if (handle == NULL || length == 0)  return S25FL_ERR_PARAM;
+    if ((address % dev->profile->sectorSize) || (length % dev->profile->sectorSize))  return S25FL_ERR_PARAM;
+    if (address >= dev->totalsize || length > dev->totalsize - address)   return S25FL_ERR_PARAM;
+    if (dev->activeHandle != NULL)   return S25FL_ERR_BUSY;
+
+    return _startHandle(dev, handle, S25FL_ASYNC_ERASE, address, NULL, length, callback, ctx);
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Comienza una programacion no bloqueante de datos que puede
+                abarcar varias paginas.
+
+    Se envia la primera pagina y se retorna inmediatamente. Las siguientes
+    se envian desde S25FL_poll a medida que la memoria termina la anterior.
+    Si el puerto provee spi_async_fnc y se programa por una sola linea, los
+    datos de cada pagina tambien se envian en segundo plano.
+
+    @param[in]  handle
+                La operacion a iniciar. Debe permanecer valida hasta que
+                termine.
+    @param[in]  address
+                La direccion donde comenzara la escritura.
+    @param[in]  buffer
+                Los datos a programar. Deben permanecer validos hasta que
+                termine la operacion.
+    @param[in]  len
+                La cantidad de bytes a programar.
+    @param[in]  callback
+                Funcion a llamar al terminar (opcional).
+    @param[in]  ctx
+                Contexto para la funcion.
+    @return     S25FL_OK si se inicio la operacion.
+*/
+/**************************************************************************/
+s25fl_err_t S25FL_startProgram (s25fl_dev_t *dev, s25fl_handle_t *handle, uint32_t address, uint8_t *buffer, uint32_t len, s25flCallback_t callback, void *ctx)
+{
+    if (handle == NULL || buffer == NULL || len == 0)   return S25FL_ERR_PARAM;
+    if (address >= dev->totalsize || len > dev->totalsize - address)  return S25FL_ERR_PARAM;
+    if (dev->activeHandle != NULL)   return S25FL_ERR_BUSY;
+
+    return _startHandle(dev, handle, S25FL_ASYNC_PROGRAM, address, buffer, len, callback, ctx);
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Comienza una lectura no bloqueante.
+
+    Se envia el comando de lectura y, si el puerto provee spi_async_fnc y
+    los datos se leen por una sola linea, los datos se reciben en segundo
+    plano mientras el programa continua. Si no, la lectura se realiza
+    completa en la primera llamada a S25FL_poll.
+
+    @param[in]  handle
+                La operacion a iniciar. Debe permanecer valida hasta que
+                termine.
+    @param[in]  address
+                La direccion donde comenzara la lectura.
+    @param[out] buffer
+                El buffer donde se guardaran los datos.
+    @param[in]  len
+                La cantidad de bytes a leer.
+    @param[in]  callback
+                Funcion a llamar al terminar (opcional).
+    @param[in]  ctx
+                Contexto para la funcion.
+    @return     S25FL_OK si se inicio la operacion.
+*/
+/**************************************************************************/
+s25fl_err_t S25FL_startRead (s25fl_dev_t *dev, s25fl_handle_t *handle, uint32_t address, uint8_t *buffer, uint32_t len, s25flCallback_t callback, void *ctx)
+{
+    if (handle == NULL || buffer == NULL || len == 0)   return S25FL_ERR_PARAM;
+    if (address >= dev->totalsize || len > dev->totalsize - address)  return S25FL_ERR_PARAM;
+    if (dev->activeHandle != NULL)   return S25FL_ERR_BUSY;
+
+    return _startHandle(dev, handle, S25FL_ASYNC_READ, address, buffer, len, callback, ctx);
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Avanza una operacion no bloqueante. Debe llamarse
+                periodicamente (por ejemplo desde el loop principal) hasta
+                que la operacion termine.
+
+    Si hay una transferencia de datos en segundo plano se retorna hasta que
+    termine. Luego se consulta una sola vez el estado de la memoria: si
+    sigue ocupada se retorna enseguida, y si termino se envia el siguiente
+    borrado, pagina o lectura. El tiempo maximo de cada paso solo se
+    controla si el puerto provee time_us_fnc.
+
+    @param[in]  handle
+                La operacion a avanzar.
+    @return     El estado de la operacion.
+*/
+/**************************************************************************/
+s25fl_handle_state_t S25FL_poll (s25fl_dev_t *dev, s25fl_handle_t *handle)
+{
+    s25fl_err_t error;
+    s25fl_op_t op;
+    uint32_t size;
+    s25fl_xfer_t xfer;
+    bool async;
+
+    if (handle == NULL) return S25FL_HANDLE_ERROR;
+    if (handle != dev->activeHandle || handle->state != S25FL_HANDLE_RUNNING)    return handle->state;
+
+    // Se espera a que termine la transferencia de datos en segundo plano
+    if (dev->dataPhase != S25FL_DATA_NONE)
+    {
+        if (dev->asyncBusy)  return handle->state;
+        _completeDataPhase(dev);
+    }
+
+    error = _pollOperation(dev);
+    if (error == S25FL_ERR_BUSY)    return handle->state;
+    if (error != S25FL_OK)
+    {
+        _finishHandle(dev, handle, error);
+        return handle->state;
+    }
+
+    // Termino el paso anterior, se contabiliza y se envia el siguiente
+    if (handle->remaining == 0)
+    {
+        // Con la politica de relectura se comprueba todo el rango al final
+        if (dev->config.verify == S25FL_VERIFY_READBACK && handle->op != S25FL_ASYNC_READ &&
+            !S25FL_verify(dev, handle->address - handle->done,
+                          (handle->op == S25FL_ASYNC_PROGRAM) ? handle->buffer - handle->done : NULL, handle->done))
+        {
+            _finishHandle(dev, handle, dev->lastError);
+            return handle->state;
+        }
+
+        _finishHandle(dev, handle, S25FL_OK);
+        return handle->state;
+    }
+
+    switch (handle->op)
+    {
+        case S25FL_ASYNC_ERASE:
+            op = _eraseStep(dev->profile, handle->address, handle->remaining, &size);
+            if (!_eraseCommand(dev, op, handle->address))
+            {
+                _finishHandle(dev, handle, dev->lastError);
+                return handle->state;
+            }
+            break;
+
+        case S25FL_ASYNC_PROGRAM:
+            size = dev->pagesize - (handle->address % dev->pagesize);
+            if (size > handle->remaining)   size = handle->remaining;
+
+            if (_blankPage(handle->buffer, size))
+            {
+                dev->blankPages++;
+                handle->buffer += size;
+                break;
+            }
+
+            _programXfer(dev, handle->address, handle->buffer, size, &xfer);
+            async = (dev->config.spi_async_fnc != NULL && dev->config.program_mode == S25FL_PROG_SINGLE);
+            if (!async)
+            {
+                if (!_programPage(dev, &xfer))
+                {
+                    _finishHandle(dev, handle, dev->lastError);
+                    return handle->state;
+                }
+            }
+            else
+            {
+                if (!_programStart(dev))
+                {
+                    _finishHandle(dev, handle, dev->lastError);
+                    return handle->state;
+                }
+                _transferStart(dev, &xfer);
+                dev->dataPhase = S25FL_DATA_PROGRAM;
+                dev->opAddress = xfer.address;
+                dev->opLen = size;
+                if (!_asyncStart(dev, handle->buffer, NULL, size))
+                {
+                    dev->config.spi_write_fnc(handle->buffer, size);
+                    _completeDataPhase(dev);
+                }
+            }
+            handle->buffer += size;
+            break;
+
+        case S25FL_ASYNC_READ:
+        default:
+            size = handle->remaining;
+
+            _readXfer(dev, handle->address, handle->buffer, size, &xfer);
+            async = (dev->config.spi_async_fnc != NULL && xfer.dataLanes == S25FL_LANES_1);
+            if (!async)
+            {
+                _transfer(dev, &xfer);
+            }
+            else
+            {
+                _transferStart(dev, &xfer);
+                dev->dataPhase = S25FL_DATA_READ;
+                if (!_asyncStart(dev, NULL, handle->buffer, size))
+                {
+                    dev->config.spi_read_fnc(handle->buffer, size);
+                    _completeDataPhase(dev);
+                }
+            }
+            handle->buffer += size;
+            break;
+    }
+
+    handle->address += size;
+    handle->remaining -= size;
+    handle->done += size;
+
+    return handle->state;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Termina la fase de datos que haya quedado pendiente (el
+                resto de una linea de la cache o la transferencia en
+                segundo plano) y libera CS. Debe llamarse antes de usar
+                otra memoria conectada al mismo bus.
+*/
+/**************************************************************************/
+void S25FL_releaseBus (s25fl_dev_t *dev)
+{
+    _completeDataPhase(dev);
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Inicializa y comienza una operacion no bloqueante.
+*/
+/**************************************************************************/
+static s25fl_err_t _startHandle(s25fl_dev_t *dev, s25fl_handle_t *handle, s25fl_async_op_t op, uint32_t address, uint8_t *buffer, uint32_t len, s25flCallback_t callback, void *ctx)
+{
+    handle->op = op;
+    handle->address = address;
+    handle->buffer = buffer;
+    handle->remaining = len;
+    handle->done = 0;
+    handle->callback = callback;
+    handle->ctx = ctx;
+    handle->error = S25FL_OK;
+    handle->state = S25FL_HANDLE_RUNNING;
+    dev->activeHandle = handle;
+
+    S25FL_poll(dev, handle);
+    return handle->error;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Comienza una transferencia en segundo plano.
+
+    @return     False si el puerto no pudo iniciarla.
+*/
+/**************************************************************************/
+static bool _asyncStart(s25fl_dev_t *dev, uint8_t *txBuffer, uint8_t *rxBuffer, uint32_t len)
+{
+    dev->asyncBusy = true;
+    if (!dev->config.spi_async_fnc(txBuffer, rxBuffer, len, _asyncDone, dev))
+    {
+        dev->asyncBusy = false;
+        return false;
+    }
+    return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Notificacion del puerto de que termino la transferencia en
+                segundo plano. Puede llamarse desde una interrupcion.
+
+    @param[in]  ctx
+                El contexto del dispositivo que inicio la transferencia.
+*/
+/**************************************************************************/
+static void _asyncDone(void *ctx)
+{
+    ((s25fl_dev_t*)ctx)->asyncBusy = false;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Espera a que termine la transferencia en segundo plano.
+*/
+/**************************************************************************/
+static void _asyncWait(s25fl_dev_t *dev)
+{
+    while (dev->asyncBusy)
+    {
+        if (dev->config.delay_us_fnc != NULL) dev->config.delay_us_fnc(1);
+    }
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Termina la fase de datos de una operacion no bloqueante,
+                esperando si es necesario a que termine la transferencia.
+                Se llama antes de cualquier otro uso del bus.
+*/
+/**************************************************************************/
+static void _completeDataPhase(s25fl_dev_t *dev)
+{
+    s25fl_data_phase_t phase = dev->dataPhase;
+
+    if (phase == S25FL_DATA_NONE)   return;
+
+    _asyncWait(dev);
+    dev->dataPhase = S25FL_DATA_NONE;
+
+    if (phase == S25FL_DATA_PROGRAM)
+    {
+        _programEnd(dev);
+    }
+    else if (phase == S25FL_DATA_LINE)
+    {
+        _readData(dev, dev->profile->readCmds[dev->config.read_mode].dataLanes,
+                  dev->fillLine->data + dev->fillLen, S25FL_CACHE_LINE - dev->fillLen);
+        dev->config.chip_select_ctrl(CS_DISABLE);
+        _cacheStore(dev->fillLine, dev->fillAddress, dev->fillOffset);
+        dev->fillLine = NULL;
+    }
+    else
+    {
+        dev->config.chip_select_ctrl(CS_DISABLE);
+    }
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Consulta sin esperar si termino la programacion o borrado
+                en curso.
+
+    @return     S25FL_OK si la memoria esta lista, S25FL_ERR_BUSY si sigue
+                ocupada, S25FL_ERR_TIMEOUT si se supero el tiempo maximo o
+                el error que reporto la memoria al terminar.
+*/
+/**************************************************************************/
+static s25fl_err_t _pollOperation(s25fl_dev_t *dev)
+{
+    if (!dev->busyPending)   return _takeError(dev);
+
+    if (!(S25FL_readStatus(dev) & SPIFLASH_STAT_BUSY))
+    {
+        _operationDone(dev);
+        return _takeError(dev);
+    }
+
+    if (dev->config.time_us_fnc != NULL && _elapsedUs(dev) >= dev->profile->timings[dev->pendingOp].maximum)
+    {
+        dev->lastError = S25FL_ERR_TIMEOUT;
+        return S25FL_ERR_TIMEOUT;
+    }
+
+    return S25FL_ERR_BUSY;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Termina una operacion no bloqueante y llama a su callback.
+*/
+/**************************************************************************/
+static void _finishHandle(s25fl_dev_t *dev, s25fl_handle_t *handle, s25fl_err_t error)
+{
+    if (error != S25FL_OK)  dev->lastError = error;
+
+    handle->error = error;
+    handle->state = (error == S25FL_OK) ? S25FL_HANDLE_DONE : S25FL_HANDLE_ERROR;
+    dev->activeHandle = NULL;
+
+    if (handle->callback != NULL)   handle->callback(handle, handle->ctx);
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Administra el deep power-down. Debe llamarse periodicamente
+                (por ejemplo desde el lazo principal): si la memoria no se
+                uso durante idle_powerdown_us y no hay ninguna operacion en
+                curso, la pone en deep power-down. El siguiente acceso la
+                despierta sin intervencion del usuario.
+
+    @return     True si la memoria esta en deep power-down.
+*/
+/**************************************************************************/
+bool S25FL_idleTask(s25fl_dev_t *dev)
+{
+    uint32_t lastAccess;
+    bool busy;
+
+    if (dev->powerState != S25FL_POWER_ACTIVE)  return dev->powerState == S25FL_POWER_DOWN;
+    if (dev->dataPhase == S25FL_DATA_LINE)  _completeDataPhase(dev);
+    if (dev->config.idle_powerdown_us == 0 || dev->config.time_us_fnc == NULL)  return false;
+    if (dev->activeHandle != NULL || dev->dataPhase != S25FL_DATA_NONE || dev->suspendDepth)  return false;
+    if (dev->maps != NULL)  return false;   // Las ventanas mapeadas se leen sin pasar por el driver
+    if (_nowUs(dev) - dev->lastAccess < dev->config.idle_powerdown_us) return false;
+
+    // Una programacion o borrado enviado sin esperar debe terminar antes.
+    // La consulta del estado no cuenta como un acceso.
+    if (dev->busyPending)
+    {
+        lastAccess = dev->lastAccess;
+        busy = (S25FL_readStatus(dev) & SPIFLASH_STAT_BUSY) != 0;
+        if (!busy)  _operationDone(dev);
+        dev->lastAccess = lastAccess;
+        if (busy)   return false;
+    }
+
+    _powerCommand(dev, S25FL_CMD_POWERDOWN);
+    _powerState(dev, S25FL_POWER_DOWN);
+    dev->powerStats.powerDowns++;
+
+    return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Despierta la memoria por adelantado, sin esperar tRES1, para
+                que un acceso proximo con latencia critica no pague el costo
+                de salir de deep power-down. Si la memoria no esta en deep
+                power-down no hace nada.
+*/
+/**************************************************************************/
+void S25FL_wakeHint(s25fl_dev_t *dev)
+{
+    if (dev->powerState != S25FL_POWER_DOWN)   return;
+
+    _wake(dev);
+    dev->powerStats.hintedWakes++;
+    dev->lastAccess = dev->wakeStart;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Obtiene los contadores de deep power-down, incluyendo el
+                tiempo transcurrido en el estado actual.
+
+    @param[out] stats
+                Donde se copian los contadores.
+*/
+/**************************************************************************/
+void S25FL_powerStats(s25fl_dev_t *dev, s25fl_power_stats_t *stats)
+{
+    uint32_t elapsed = _nowUs(dev) - dev->powerSince;
+
+    *stats = dev->powerStats;
+    if (dev->powerState == S25FL_POWER_DOWN)   stats->powerDownUs += elapsed;
+    else stats->activeUs += elapsed;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Registra un acceso a la memoria y, si esta en deep
+                power-down, la despierta. Si ya se envio el comando de
+                salida (S25FL_wakeHint) solo se espera lo que falte de tRES1.
+*/
+/**************************************************************************/
+static void _access(s25fl_dev_t *dev)
+{
+    uint32_t elapsed;
+
+    if (dev->powerState != S25FL_POWER_ACTIVE)
+    {
+        if (dev->powerState == S25FL_POWER_DOWN)
+        {
+            _wake(dev);
+            dev->powerStats.demandWakes++;
+        }
+
+        elapsed = _nowUs(dev) - dev->wakeStart;
+        if (dev->config.time_us_fnc == NULL)   elapsed = 0;
+        if (elapsed < S25FL_TRES1_US)
+        {
+            _delayUs(dev, S25FL_TRES1_US - elapsed);
+            dev->powerStats.wakeWaitUs += S25FL_TRES1_US - elapsed;
+        }
+        _powerState(dev, S25FL_POWER_ACTIVE);
+    }
+
+    dev->lastAccess = _nowUs(dev);
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Envia el comando de salida de deep power-down, sin esperar
+                tRES1.
+*/
+/**************************************************************************/
+static void _wake(s25fl_dev_t *dev)
+{
+    // Los comandos enviados antes de tDPD desde la entrada se ignoran
+    uint32_t elapsed = _nowUs(dev) - dev->powerSince;
+
+    if (dev->config.time_us_fnc == NULL)   elapsed = 0;
+    if (elapsed < S25FL_TDPD_US)   _delayUs(dev, S25FL_TDPD_US - elapsed);
+
+    _powerCommand(dev, S25FL_CMD_RPWRDDEVID);
+    dev->wakeStart = _nowUs(dev);
+    _powerState(dev, S25FL_POWER_WAKING);
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Envia un comando de un byte para entrar o salir de deep
+                power-down, sin pasar por _transfer.
+*/
+/**************************************************************************/
+static void _powerCommand(s25fl_dev_t *dev, uint8_t opcode)
+{
+    if (dev->continuous)    _modeReset(dev, dev->profile->readCmds[dev->config.read_mode].addrLanes);
+
+    _setClock(dev, S25FL_CLK_CONTROL);
+    dev->config.chip_select_ctrl(CS_ENABLE);
+    dev->config.spi_writeByte_fnc(opcode);
+    dev->config.chip_select_ctrl(CS_DISABLE);
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Cambia el estado de energia, acumulando el tiempo pasado en
+                el estado anterior.
+*/
+/**************************************************************************/
+static void _powerState(s25fl_dev_t *dev, s25fl_power_state_t state)
+{
+    uint32_t now = _nowUs(dev);
+
+    if (dev->powerState == S25FL_POWER_DOWN)   dev->powerStats.powerDownUs += now - dev->powerSince;
+    else dev->powerStats.activeUs += now - dev->powerSince;
+
+    dev->powerState = state;
+    dev->powerSince = now;
+}
+
+/**************************************************************************/
+/*! 
+    @return     El tiempo actual en microsegundos, o 0 si el puerto no
+                provee time_us_fnc.
+*/
+/**************************************************************************/
+static uint32_t _nowUs(s25fl_dev_t *dev)
+{
+    return (dev->config.time_us_fnc != NULL) ? dev->config.time_us_fnc() : 0;
+}
+
+/**************************************************************************/
+/*! 
+    @return     El tamaño de pagina de la flash.
+*/
+/**************************************************************************/
+int32_t S25FL_pageSize(s25fl_dev_t *dev)
+{
+    return dev->pagesize;
+}
+
+/**************************************************************************/
+/*! 
+    @return     La cantidad de bits de las direcciones de memoria.
+*/
+/**************************************************************************/
+int8_t S25FL_addressSize(s25fl_dev_t *dev)
+{
+    return dev->addrsize;
+}
+
+/**************************************************************************/
+/*! 
+    @return     El numero total de paginas de la flash.
+*/
+/**************************************************************************/
+int32_t S25FL_numPages(s25fl_dev_t *dev)
+{
+    return dev->pages;
+}
+
+/**************************************************************************/
+/*! 
+    @return     El tamaño del sector de borrado minimo de la flash.
+*/
+/**************************************************************************/
+uint32_t S25FL_sectorSize(s25fl_dev_t *dev)
+{
+    return dev->profile->sectorSize;
+}
+
+/**************************************************************************/
+/*! 
+    @return     La capacidad total de la flash en bytes.
+*/
+/**************************************************************************/
+uint32_t S25FL_capacity(s25fl_dev_t *dev)
+{
+    return dev->totalsize;
+}
+
+/**************************************************************************/
+/*! 
+    @return     El perfil del modelo de memoria configurado.
+*/
+/**************************************************************************/
+const s25fl_profile_t* S25FL_profile(s25fl_dev_t *dev)
+{
+    return dev->profile;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Cantidad de paginas en 0xFF que no se programaron, para
+                evaluar cuanto tiempo de programacion se ahorra.
+
+    @param[in]  reset
+                True para volver a cero el contador luego de leerlo.
+    @return     Las paginas salteadas desde la inicializacion o el ultimo
+                reinicio del contador.
+*/
+/**************************************************************************/
+uint32_t S25FL_blankPages(s25fl_dev_t *dev, bool reset)
+{
+    uint32_t pages = dev->blankPages;
+
+    if (reset)  dev->blankPages = 0;
+
+    return pages;
+}
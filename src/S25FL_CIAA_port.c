@@ -8,6 +8,24 @@
 
 #include "S25FL_CIAA_port.h"
 
+// Los accesos al SSP del nucleo de transferencia van directo a los
+// registros, sin una llamada a funcion por frame
+#define S25FL_SSP_STATUS()		(LPC_SSP1->SR)
+#define S25FL_SSP_WRITE(data)	(LPC_SSP1->DR = (data))
+#define S25FL_SSP_READ()		(LPC_SSP1->DR)
+#include "S25FL_ssp.h"
+
+// Estado de la transferencia por DMA en curso
+static uint8_t dmaChannelTx, dmaChannelRx;
+static uint8_t *dmaTx, *dmaRx;
+static uint32_t dmaRemaining;
+static spiDone_t dmaDone = NULL;
+static void *dmaCtx;
+static uint8_t dmaDummyTx = 0xFF;
+static uint8_t dmaDummyRx;
+
+static void _dmaStartChunk();
+
 /*************************************************************************************************
 	 *  @brief Funcion para set/reset del chip enable
      *
@@ -33,6 +51,29 @@ void chipSelect_CIAA_port(csState_t estado)  {
 	}
 }
 
+/*************************************************************************************************
+	 *  @brief Funcion para set/reset del chip enable de la segunda memoria del bus
+     *
+	 *  @param		estado	Determina la accion a ser tomada con el pin CS.
+	 *  @return     None.
+***************************************************************************************************/
+void chipSelect2_CIAA_port(csState_t estado)  {
+
+	switch(estado)  {
+
+	case CS_ENABLE:
+        gpioWrite ( MEMORY2_CS, LOW );
+		break;
+
+	case CS_DISABLE:
+        gpioWrite ( MEMORY2_CS, HIGH );
+		break;
+
+	default:
+		;
+	}
+}
+
 /*************************************************************************************************
 	 *  @brief Funcion para leer datos mediante SPI
      *
@@ -44,8 +85,8 @@ void chipSelect_CIAA_port(csState_t estado)  {
 ***************************************************************************************************/
 bool_t spiRead_CIAA_port(uint8_t* buffer, uint32_t bufferSize)
 {
-    if(spiRead(SPI0, buffer, bufferSize)) return true;
-    else return false;
+	_sspTransfer(NULL, 0, NULL, buffer, bufferSize);
+	return true;
 }
 
 /**************************************************************************/
@@ -59,21 +100,10 @@ bool_t spiRead_CIAA_port(uint8_t* buffer, uint32_t bufferSize)
 /**************************************************************************/
 uint8_t spiReadRegister_CIAA_port(uint8_t reg)
 {
-	Chip_SSP_DATA_SETUP_T xferConfig;
-	uint8_t rxBuff[1];
-	uint8_t* txBuff = &reg;
-	bool res;
-
-	xferConfig.tx_data = txBuff;
-	xferConfig.tx_cnt  = 0;
-	xferConfig.rx_data = rxBuff;
-	xferConfig.rx_cnt  = 0;
-	xferConfig.length  = 1;
+	uint8_t data;
 
-	Chip_SSP_RWFrames_Blocking(LPC_SSP1,  &xferConfig);
-	//Chip_SSP_Int_RWFrames8Bits( LPC_SSP1, &xferConfig );
-
-	return rxBuff[0];
+	_sspTransfer(NULL, 0, &reg, &data, 1);
+	return data;
 }
 
 /**************************************************************************/
@@ -88,17 +118,7 @@ uint8_t spiReadRegister_CIAA_port(uint8_t reg)
 /**************************************************************************/
 void spiWrite_CIAA_port(uint8_t* buffer, uint32_t bufferSize)
 {
-	Chip_SSP_DATA_SETUP_T xferConfig;
-
-	xferConfig.tx_data = buffer;
-	xferConfig.tx_cnt  = 0;
-	xferConfig.rx_data = NULL;
-	xferConfig.rx_cnt  = 0;
-	xferConfig.length  = bufferSize;
-
-	Chip_SSP_RWFrames_Blocking(LPC_SSP1,  &xferConfig);
-	//Chip_SSP_Int_RWFrames8Bits( LPC_SSP1, &xferConfig );
-	while(Chip_SSP_GetStatus(LPC_SSP1, SSP_STAT_BSY));
+	_sspTransfer(NULL, 0, buffer, NULL, bufferSize);
 }
 
 /**************************************************************************/
@@ -111,17 +131,42 @@ void spiWrite_CIAA_port(uint8_t* buffer, uint32_t bufferSize)
 /**************************************************************************/
 void spiWriteByte_CIAA_port(uint8_t data)
 {
-	Chip_SSP_DATA_SETUP_T xferConfig;
+	_sspTransfer(NULL, 0, &data, NULL, 1);
+}
 
-	xferConfig.tx_data = &data;
-	xferConfig.tx_cnt  = 0;
-	xferConfig.rx_data = NULL;
-	xferConfig.rx_cnt  = 0;
-	xferConfig.length  = 1;
+/**************************************************************************/
+/*! 
+    @brief      Realiza una transaccion completa (comando, direccion, modo,
+                latencia y datos) manteniendo el FIFO del SSP lleno, sin
+                esperar a que se vacie entre una fase y la siguiente. El
+                driver maneja CS antes y despues de la llamada.
 
-	//Chip_SSP_RWFrames_Blocking(LPC_SSP1,  &xferConfig);
-	Chip_SSP_Int_RWFrames8Bits( LPC_SSP1, &xferConfig );
-	while(Chip_SSP_GetStatus(LPC_SSP1, SSP_STAT_BSY));
+    @param[in]  xfer
+				La transaccion a realizar.
+    @return  	False si la transaccion usa mas de una linea, que el SSP no
+				soporta.
+*/
+/**************************************************************************/
+bool spiTransfer_CIAA_port(const s25fl_xfer_t *xfer)
+{
+	uint8_t header[1 + 4 + 1 + 8];
+	uint32_t n = 0, i;
+
+	if (xfer->addrLanes != S25FL_LANES_1 || xfer->dataLanes != S25FL_LANES_1)	return false;
+
+	if (!xfer->skipOpcode)	header[n++] = xfer->opcode;
+	for (i = xfer->addrBytes; i > 0; i--)
+	{
+		header[n++] = (xfer->address >> (8 * (i - 1))) & 0xFF;
+	}
+	if (xfer->modeCycles)	header[n++] = xfer->mode;
+	for (i = 0; i < xfer->dummyCycles / 8; i++)
+	{
+		header[n++] = 0xFF;
+	}
+
+	_sspTransfer(header, n, xfer->txData, xfer->rxData, xfer->len);
+	return true;
 }
 
 /**************************************************************************/
@@ -136,3 +181,195 @@ void delay_CIAA_port(uint32_t millisecs)
 {
 	delay((tick_t)millisecs);
 }
+
+/**************************************************************************/
+/*! 
+    @brief      Configura el clock del SSP segun la clase de comando que el
+                driver va a enviar.
+
+    @param[in]  clock
+				La clase de comando a enviar.
+*/
+/**************************************************************************/
+void spiSetClock_CIAA_port(s25fl_clock_t clock)
+{
+	switch(clock)
+	{
+	case S25FL_CLK_READ:
+		Chip_SSP_SetBitRate(LPC_SSP1, CIAA_SPI_CLK_READ);
+		break;
+
+	case S25FL_CLK_FAST:
+		Chip_SSP_SetBitRate(LPC_SSP1, CIAA_SPI_CLK_FAST);
+		break;
+
+	case S25FL_CLK_CONTROL:
+	default:
+		Chip_SSP_SetBitRate(LPC_SSP1, CIAA_SPI_CLK_CONTROL);
+		break;
+	}
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Obtiene el tiempo transcurrido en microsegundos a partir del
+                contador de ciclos del nucleo (DWT).
+
+    El contador de ciclos desborda cada pocos segundos, por lo que se
+    acumulan las diferencias entre llamadas. Debe llamarse al menos una
+    vez por cada desborde del contador para no perder tiempo.
+
+    @return  	Contador libre en microsegundos.
+*/
+/**************************************************************************/
+uint32_t timeUs_CIAA_port()
+{
+	static bool initialized = false;
+	static uint32_t lastCycles, cycles, micros;
+	uint32_t now, cyclesPerUs = SystemCoreClock / 1000000;
+
+	if (!initialized)
+	{
+		CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+		DWT->CYCCNT = 0;
+		DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+		lastCycles = 0;
+		initialized = true;
+	}
+
+	now = DWT->CYCCNT;
+	cycles += now - lastCycles;
+	lastCycles = now;
+
+	micros += cycles / cyclesPerUs;
+	cycles %= cyclesPerUs;
+
+	return micros;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Funcion para realizar un delay bloqueante en microsegundos.
+
+    @param[in]  microsecs
+				La cantidad de microsegundos del delay.          
+*/
+/**************************************************************************/
+void delayUs_CIAA_port(uint32_t microsecs)
+{
+	uint32_t start = timeUs_CIAA_port();
+
+	while ((timeUs_CIAA_port() - start) < microsecs);
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Inicializa el GPDMA para transferencias por el SSP1. Debe
+                llamarse luego de inicializar el SPI.
+*/
+/**************************************************************************/
+void spiDmaInit_CIAA_port()
+{
+	Chip_GPDMA_Init(LPC_GPDMA);
+	dmaChannelTx = Chip_GPDMA_GetFreeChannel(LPC_GPDMA, GPDMA_CONN_SSP1_Tx);
+	dmaChannelRx = Chip_GPDMA_GetFreeChannel(LPC_GPDMA, GPDMA_CONN_SSP1_Rx);
+
+	NVIC_DisableIRQ(DMA_IRQn);
+	NVIC_SetPriority(DMA_IRQn, ((0x01 << 3) | 0x01));
+	NVIC_EnableIRQ(DMA_IRQn);
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Comienza una transferencia por DMA en el SSP1.
+
+    Siempre se usan los dos canales ya que el SSP es full duplex: el de
+    transmision genera el clock (enviando 0xFF si no hay datos) y el de
+    recepcion vacia el FIFO (descartando los datos si no hay buffer).
+
+    @param[in]  txBuffer
+				Los datos a enviar, o NULL para enviar 0xFF.
+	@param[out]	rxBuffer
+				Donde guardar los datos recibidos, o NULL para descartarlos.
+	@param[in]	len
+				La cantidad de bytes a transferir.
+	@param[in]	done
+				Funcion a llamar desde la interrupcion al terminar.
+	@param[in]	ctx
+				Contexto a pasarle a done.
+    @return  	False si ya hay una transferencia en curso.
+*/
+/**************************************************************************/
+bool spiAsync_CIAA_port(uint8_t *txBuffer, uint8_t *rxBuffer, uint32_t len, spiDone_t done, void *ctx)
+{
+	if (dmaDone != NULL || len == 0)	return false;
+
+	dmaTx = txBuffer;
+	dmaRx = rxBuffer;
+	dmaRemaining = len;
+	dmaDone = done;
+	dmaCtx = ctx;
+
+	// Se descartan los datos que hayan quedado en el FIFO de recepcion
+	while (Chip_SSP_GetStatus(LPC_SSP1, SSP_STAT_RNE))	Chip_SSP_ReceiveFrame(LPC_SSP1);
+
+	Chip_SSP_DMA_Enable(LPC_SSP1);
+	_dmaStartChunk();
+
+	return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Programa los canales del GPDMA para el siguiente tramo de la
+                transferencia, de hasta CIAA_DMA_MAX_CHUNK bytes.
+*/
+/**************************************************************************/
+static void _dmaStartChunk()
+{
+	DMA_TransferDescriptor_t txDesc, rxDesc;
+	uint32_t chunk = (dmaRemaining > CIAA_DMA_MAX_CHUNK) ? CIAA_DMA_MAX_CHUNK : dmaRemaining;
+
+	Chip_GPDMA_InitDescriptor(LPC_GPDMA, &rxDesc, GPDMA_CONN_SSP1_Rx,
+							  (dmaRx != NULL) ? (uint32_t)dmaRx : (uint32_t)&dmaDummyRx,
+							  chunk, GPDMA_TRANSFERTYPE_P2M_CONTROLLER_DMA, NULL);
+	if (dmaRx == NULL)	rxDesc.ctrl &= ~GPDMA_DMACCxControl_DI;
+
+	Chip_GPDMA_InitDescriptor(LPC_GPDMA, &txDesc,
+							  (dmaTx != NULL) ? (uint32_t)dmaTx : (uint32_t)&dmaDummyTx,
+							  GPDMA_CONN_SSP1_Tx, chunk, GPDMA_TRANSFERTYPE_M2P_CONTROLLER_DMA, NULL);
+	if (dmaTx == NULL)	txDesc.ctrl &= ~GPDMA_DMACCxControl_SI;
+
+	// Se inicia primero la recepcion para no perder datos
+	Chip_GPDMA_SGTransfer(LPC_GPDMA, dmaChannelRx, &rxDesc, GPDMA_TRANSFERTYPE_P2M_CONTROLLER_DMA);
+	Chip_GPDMA_SGTransfer(LPC_GPDMA, dmaChannelTx, &txDesc, GPDMA_TRANSFERTYPE_M2P_CONTROLLER_DMA);
+
+	if (dmaTx != NULL)	dmaTx += chunk;
+	if (dmaRx != NULL)	dmaRx += chunk;
+	dmaRemaining -= chunk;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Interrupcion del GPDMA. La transferencia termina cuando el
+                canal de recepcion recibio todos los bytes.
+*/
+/**************************************************************************/
+void DMA_IRQHandler(void)
+{
+	spiDone_t done;
+
+	Chip_GPDMA_Interrupt(LPC_GPDMA, dmaChannelTx);
+	if (Chip_GPDMA_Interrupt(LPC_GPDMA, dmaChannelRx) != SUCCESS)	return;
+
+	if (dmaRemaining > 0)
+	{
+		_dmaStartChunk();
+		return;
+	}
+
+	Chip_SSP_DMA_Disable(LPC_SSP1);
+	done = dmaDone;
+	dmaDone = NULL;
+	if (done != NULL)	done(dmaCtx);
+}
@@ -0,0 +1,1427 @@
+/*
+ *  S25FL_host_port.c
+ *
+ *  Created on: 17-09-2021
+ *  Author: Martin Rios - jrios@fi.uba.ar
+ *
+ */
+
+#ifdef S25FL_HOST_PORT
+
+#include "S25FL_host_port.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// El nucleo de transferencia del puerto de la CIAA se ejecuta sobre el
+// SSP emulado, definido al final del archivo
+static uint32_t _sspStatus();
+static void _sspWrite(uint8_t data);
+static uint8_t _sspRead();
+
+#define S25FL_SSP_STATUS()      _sspStatus()
+#define S25FL_SSP_WRITE(data)   _sspWrite(data)
+#define S25FL_SSP_READ()        _sspRead()
+#include "S25FL_ssp.h"
+
+// Clock del bus emulado para cada clase de comando
+#define HOST_SPI_CLK_CONTROL    10000000
+#define HOST_SPI_CLK_READ       50000000
+#define HOST_SPI_CLK_FAST       108000000
+
+// Tiempos tipicos de programacion y borrado en microsegundos
+#define HOST_T_PP_US            450
+#define HOST_T_SE_US            45000
+#define HOST_T_BE32_US          150000
+#define HOST_T_BE64_US          220000
+#define HOST_T_CE_US            16000000
+#define HOST_T_W_US             145000
+#define HOST_T_SL_US            20          // Latencia de suspension
+#define HOST_T_RS_US            100         // Minimo entre reanudacion y suspension
+#define HOST_T_DPD_US           3           // Entrada en deep power-down
+#define HOST_T_RES1_US          30          // Salida de deep power-down
+
+// Costo fijo de cada llamada al puerto: preparar la transferencia y esperar
+// a que el SSP termine de vaciar el FIFO
+#define HOST_CALL_OVERHEAD_NS   1000
+#define HOST_SSP_ACCESS_NS      10          // Acceso a un registro del SSP emulado (unos ciclos del bus APB)
+
+#define HOST_CHIPS              2           // Memorias en el bus, cada una con su CS
+#define HOST_SUSPEND_JUNK       0x5A        // Base de los datos invalidos de una operacion suspendida
+#define HOST_FRAME_MAX          (1 + 4 + 4 + 256)
+#define HOST_PAGESIZE           256
+#define HOST_SFDP_BFPT          0x10        // Direccion de la tabla basica de parametros
+#define HOST_SFDP_SIZE          (HOST_SFDP_BFPT + S25FL_SFDP_BFPT_DWORDS * 4)
+
+static uint32_t memorySize;
+static s25fl_lanes_t maxLanes;
+static uint64_t nowNs;
+static uint32_t clockHz = HOST_SPI_CLK_CONTROL;
+
+// Estado de cada memoria emulada. Todas comparten el bus y cada una tiene
+// su propio CS, por lo que los datos del bus van a la memoria seleccionada.
+typedef struct
+{
+    uint8_t *memory;
+    bool imageMapped;               // La memoria es un archivo mapeado con image_host_port
+    uint8_t status1;
+    uint8_t status2;
+    uint8_t config1;
+    uint8_t busyStatus2;            // Bit de SR2 a activar si se suspende la operacion en curso
+    uint64_t suspendedNs;           // Tiempo restante de la operacion suspendida
+    uint32_t opAddress;             // Region que modifica la operacion en curso, cuyos
+    uint32_t opLen;                 // datos no son validos mientras esta suspendida
+    uint64_t lastResumeNs;
+    uint64_t busyUntilNs;
+    bool powerDown;                 // En deep power-down
+    uint64_t standbyNs;             // Momento en que termina de entrar o salir de deep power-down
+    host_fault_t fault;             // Falla a inyectar en una programacion o borrado
+    uint32_t faultSkip;             // Programaciones y borrados que se completan antes de la falla
+    uint8_t continuousOpcode;       // Lectura en curso si esta en lectura continua (0 si no)
+    uint8_t wrap;                   // Largo de la rafaga circular de Quad I/O Read (0: lineal)
+
+    // Comando en curso (desde que se habilita CS)
+    uint8_t frame[HOST_FRAME_MAX];
+    uint32_t frameLen;
+    uint32_t readPos;
+    bool selected;
+} host_chip_t;
+
+static host_chip_t chips[HOST_CHIPS];
+static host_chip_t *chip = &chips[0];
+
+// Transferencia en segundo plano emulada: los datos se mueven al iniciarla
+// y la notificacion se entrega cuando el tiempo emulado alcanza su fin
+static spiDone_t asyncDone = NULL;
+static void *asyncCtx;
+static uint64_t asyncEndNs;
+
+static host_port_stats_t stats;
+static uint64_t statsStartNs;
+
+// SSP emulado: FIFO de transmision y de recepcion y registro de
+// desplazamiento, que avanzan con el tiempo emulado
+typedef struct
+{
+    uint8_t tx[S25FL_SSP_FIFO_DEPTH];
+    uint64_t txReadyNs[S25FL_SSP_FIFO_DEPTH];   // Momento en que se escribio cada frame
+    uint8_t txHead, txCount;
+    uint8_t rx[S25FL_SSP_FIFO_DEPTH];
+    uint8_t rxHead, rxCount;
+    bool shifting;
+    uint8_t shiftData;
+    uint64_t shiftEndNs;
+    uint64_t lineFreeNs;                        // Fin del ultimo frame desplazado
+    uint32_t frame;                             // Frames desplazados en la llamada en curso
+    uint32_t headerLen;
+    bool txData, rxData;
+} host_ssp_t;
+
+static host_ssp_t ssp;
+static bool sspPrimed = true;
+
+// Tabla SFDP que devuelven las memorias: la de la S25FL-L armada al
+// inicializar, o la cargada con sfdp_host_port (NULL: sin tabla)
+static uint8_t sfdpFixture[HOST_SFDP_SIZE];
+static const uint8_t *sfdp;
+static uint32_t sfdpLen;
+
+/**************************************************************************/
+/*!
+    @brief      Avanza el tiempo emulado segun los ciclos de bus consumidos.
+
+    @param[in]  bytes
+                Cantidad de bytes transferidos.
+    @param[in]  lanes
+                Cantidad de lineas usadas en la transferencia.
+*/
+/**************************************************************************/
+static void _busTransfer(uint32_t bytes, s25fl_lanes_t lanes)
+{
+    uint64_t cycles = ((uint64_t)bytes * 8) / lanes;
+
+    stats.portCalls++;
+    nowNs += HOST_CALL_OVERHEAD_NS;
+
+    stats.busCycles += cycles;
+    nowNs += (cycles * 1000000000ULL) / clockHz;
+}
+
+/**************************************************************************/
+/*!
+    @return     True si la memoria emulada esta ocupada programando o borrando.
+*/
+/**************************************************************************/
+static bool _busy()
+{
+    return nowNs < chip->busyUntilNs;
+}
+
+/**************************************************************************/
+/*!
+    @return     La cantidad de bytes de direccion del comando en curso: 4
+                para las variantes con direccion de 4 bytes, 3 para el resto.
+*/
+/**************************************************************************/
+static uint8_t _frameAddrBytes()
+{
+    switch (chip->frame[0])
+    {
+        case S25FL_CMD_READ4:
+        case S25FL_CMD_FREAD4:
+        case S25FL_CMD_FREADDUALOUT4:
+        case S25FL_CMD_FREADDUALIO4:
+        case S25FL_CMD_FREADQUADOUT4:
+        case S25FL_CMD_FREADQUADIO4:
+        case S25FL_CMD_PAGEPROG4:
+        case S25FL_CMD_QUADPAGEPROG4:
+        case S25FL_CMD_SECTERASE4_4:
+        case S25FL_CMD_BLOCKERASE32_4:
+        case S25FL_CMD_BLOCKERASE64_4:
+            return 4;
+        default:
+            return 3;
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief      Obtiene la direccion de 3 o 4 bytes enviada luego del comando.
+*/
+/**************************************************************************/
+static uint32_t _frameAddress()
+{
+    uint32_t address = 0;
+    uint8_t i;
+
+    for (i = 1; i <= _frameAddrBytes(); i++)
+    {
+        address = (address << 8) | chip->frame[i];
+    }
+    return address % memorySize;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Obtiene la cantidad de bytes de encabezado (comando, direccion,
+                modo y latencia) y las lineas de datos de un comando de lectura.
+
+    @return     False si el comando no es una lectura de la memoria.
+*/
+/**************************************************************************/
+static bool _readCommand(uint8_t opcode, uint32_t *header, s25fl_lanes_t *lanes)
+{
+    switch (opcode)
+    {
+        case SPIFLASH_SPI_DATAREAD:
+        case S25FL_CMD_READ4:           *header = 1;        *lanes = S25FL_LANES_1; break;
+        case S25FL_CMD_FREAD:
+        case S25FL_CMD_FREAD4:          *header = 2;        *lanes = S25FL_LANES_1; break;
+        case S25FL_CMD_FREADDUALOUT:
+        case S25FL_CMD_FREADDUALOUT4:   *header = 2;        *lanes = S25FL_LANES_2; break;
+        case S25FL_CMD_FREADDUALIO:
+        case S25FL_CMD_FREADDUALIO4:    *header = 2;        *lanes = S25FL_LANES_2; break;
+        case S25FL_CMD_FREADQUADOUT:
+        case S25FL_CMD_FREADQUADOUT4:   *header = 2;        *lanes = S25FL_LANES_4; break;
+        case S25FL_CMD_FREADQUADIO:
+        case S25FL_CMD_FREADQUADIO4:    *header = 1 + 1 + 2; *lanes = S25FL_LANES_4; break;
+        default:
+            return false;
+    }
+    *header += _frameAddrBytes();
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @return     El comando de lectura del comando en curso si sus bits de
+                modo (Axh) dejan la memoria en lectura continua, 0 si no.
+*/
+/**************************************************************************/
+static uint8_t _continuousOpcode()
+{
+    uint32_t modeIndex = 1 + _frameAddrBytes();
+
+    switch (chip->frame[0])
+    {
+        case S25FL_CMD_FREADDUALIO:
+        case S25FL_CMD_FREADDUALIO4:
+        case S25FL_CMD_FREADQUADIO:
+        case S25FL_CMD_FREADQUADIO4:
+            break;
+        default:
+            return 0;
+    }
+
+    if (chip->frameLen <= modeIndex || (chip->frame[modeIndex] & 0xF0) != S25FL_MODE_CONTINUOUS)  return 0;
+    return chip->frame[0];
+}
+
+/**************************************************************************/
+/*!
+    @brief      Ocupa la memoria emulada durante el tiempo indicado.
+*/
+/**************************************************************************/
+static void _startBusy(uint32_t us)
+{
+    chip->busyUntilNs = nowNs + (uint64_t)us * 1000;
+    chip->status1 &= ~SPIFLASH_STAT_WRTEN;
+    chip->busyStatus2 = 0;
+    chip->opLen = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Aplica la falla inyectada, si la hay, a la programacion o
+                borrado recibido: la memoria queda ocupada el tiempo normal
+                pero no se modifica. Si se reporta, se activa el bit de error
+                de SR2 y WEL queda activo hasta el Clear Status Register.
+
+    @param[in]  errorBit
+                S25FL_STAT2_P_ERR o S25FL_STAT2_E_ERR.
+    @param[in]  us
+                El tiempo de la operacion.
+    @return     True si se inyecto la falla.
+*/
+/**************************************************************************/
+static bool _fault(uint8_t errorBit, uint32_t us)
+{
+    host_fault_t fault = chip->fault;
+
+    if (fault == HOST_FAULT_NONE)   return false;
+    if (chip->faultSkip > 0)
+    {
+        chip->faultSkip--;
+        return false;
+    }
+
+    chip->fault = HOST_FAULT_NONE;
+    _startBusy(us);
+    if (fault == HOST_FAULT_REPORTED)
+    {
+        chip->status2 |= errorBit;
+        chip->status1 |= SPIFLASH_STAT_WRTEN;
+    }
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Borra una region alineada de la memoria emulada.
+*/
+/**************************************************************************/
+static void _erase(uint32_t size, uint32_t us)
+{
+    uint32_t address = _frameAddress() & ~(size - 1);
+
+    if (_fault(S25FL_STAT2_E_ERR, us))  return;
+
+    stats.erases++;
+    memset(chip->memory + address, 0xFF, size);
+    _startBusy(us);
+    chip->busyStatus2 = S25FL_STAT2_ES;
+    chip->opAddress = address;
+    chip->opLen = size;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Ejecuta los comandos de escritura al deshabilitar CS, tal como
+                lo hace la memoria real.
+*/
+/**************************************************************************/
+static void _execute()
+{
+    uint32_t address, i, start;
+
+    if (chip->frameLen == 0)  return;
+
+    stats.commands++;
+
+    // Los bits de modo de cada lectura dual o quad I/O deciden si la
+    // memoria sigue en lectura continua. Cualquier otra cosa, incluido el
+    // Mode Bit Reset, la saca.
+    chip->continuousOpcode = _continuousOpcode();
+
+    // En deep power-down, o mientras entra o sale, los comandos se ignoran
+    // salvo el de salida
+    if (nowNs < chip->standbyNs || (chip->powerDown && chip->frame[0] != S25FL_CMD_RPWRDDEVID))
+    {
+        stats.powerDownErrors++;
+        return;
+    }
+    if (chip->frame[0] == S25FL_CMD_RPWRDDEVID)
+    {
+        if (chip->powerDown)    chip->standbyNs = nowNs + (uint64_t)HOST_T_RES1_US * 1000;
+        chip->powerDown = false;
+        return;
+    }
+
+    // La suspension y reanudacion se aceptan con la memoria ocupada
+    if (chip->frame[0] == S25FL_CMD_ERASESUSPEND)
+    {
+        if (!_busy() || !chip->busyStatus2)   return;
+        if (chip->lastResumeNs && nowNs - chip->lastResumeNs < (uint64_t)HOST_T_RS_US * 1000)  stats.suspendErrors++;
+        chip->suspendedNs = chip->busyUntilNs - nowNs;
+        chip->busyUntilNs = nowNs + (uint64_t)HOST_T_SL_US * 1000;
+        chip->status2 |= chip->busyStatus2;
+        return;
+    }
+    if (chip->frame[0] == S25FL_CMD_ERASERESUME)
+    {
+        if (!(chip->status2 & (S25FL_STAT2_PS | S25FL_STAT2_ES)) || _busy())   return;
+        chip->busyUntilNs = nowNs + chip->suspendedNs;
+        chip->status2 &= ~(S25FL_STAT2_PS | S25FL_STAT2_ES);
+        chip->lastResumeNs = nowNs;
+        return;
+    }
+
+    // Mientras la memoria esta ocupada solo acepta la lectura de estado
+    if (_busy())    return;
+
+    switch (chip->frame[0])
+    {
+        case S25FL_CMD_WRITEENABLE:
+            chip->status1 |= SPIFLASH_STAT_WRTEN;
+            break;
+
+        case S25FL_CMD_WRITEDISABLE:
+            chip->status1 &= ~SPIFLASH_STAT_WRTEN;
+            break;
+
+        case S25FL_CMD_SBL:
+            if (chip->frameLen < 2) break;
+            chip->wrap = (chip->frame[1] & S25FL_WRAP_DISABLE) ? 0 : 8 << (chip->frame[1] & 0x03);
+            break;
+
+        case S25FL_CMD_CLSR:
+            chip->status1 &= ~SPIFLASH_STAT_WRTEN;
+            chip->status2 &= ~(S25FL_STAT2_P_ERR | S25FL_STAT2_E_ERR);
+            break;
+
+        case S25FL_CMD_WRITESTAT:
+            if (!(chip->status1 & SPIFLASH_STAT_WRTEN) || chip->frameLen < 2)   break;
+            chip->status1 = chip->frame[1] & ~(SPIFLASH_STAT_BUSY | SPIFLASH_STAT_WRTEN);
+            if (chip->frameLen > 2)   chip->config1 = chip->frame[2];
+            _startBusy(HOST_T_W_US);
+            break;
+
+        case S25FL_CMD_PAGEPROG:
+        case S25FL_CMD_QUADPAGEPROG:
+        case S25FL_CMD_PAGEPROG4:
+        case S25FL_CMD_QUADPAGEPROG4:
+            start = 1 + _frameAddrBytes();
+            if (!(chip->status1 & SPIFLASH_STAT_WRTEN) || chip->frameLen < start)   break;
+            if (_fault(S25FL_STAT2_P_ERR, HOST_T_PP_US))  break;
+            stats.programs++;
+            address = _frameAddress();
+            // Los datos que exceden la pagina vuelven al comienzo de la misma
+            for (i = start; i < chip->frameLen; i++)
+            {
+                uint32_t offset = (address + i - start) % HOST_PAGESIZE;
+                chip->memory[(address & ~(HOST_PAGESIZE - 1)) + offset] &= chip->frame[i];
+            }
+            _startBusy(HOST_T_PP_US);
+            chip->busyStatus2 = S25FL_STAT2_PS;
+            chip->opAddress = address & ~(HOST_PAGESIZE - 1);
+            chip->opLen = HOST_PAGESIZE;
+            break;
+
+        case S25FL_CMD_SECTERASE4:
+        case S25FL_CMD_SECTERASE4_4:
+            if (!(chip->status1 & SPIFLASH_STAT_WRTEN) || chip->frameLen < (uint32_t)(1 + _frameAddrBytes()))   break;
+            _erase(4096, HOST_T_SE_US);
+            break;
+
+        case S25FL_CMD_BLOCKERASE32:
+        case S25FL_CMD_BLOCKERASE32_4:
+            if (!(chip->status1 & SPIFLASH_STAT_WRTEN) || chip->frameLen < (uint32_t)(1 + _frameAddrBytes()))   break;
+            _erase(32768, HOST_T_BE32_US);
+            break;
+
+        case S25FL_CMD_BLOCKERASE64:
+        case S25FL_CMD_BLOCKERASE64_4:
+            if (!(chip->status1 & SPIFLASH_STAT_WRTEN) || chip->frameLen < (uint32_t)(1 + _frameAddrBytes()))   break;
+            _erase(65536, HOST_T_BE64_US);
+            break;
+
+        case S25FL_CMD_CHIPERASE:
+            if (!(chip->status1 & SPIFLASH_STAT_WRTEN))   break;
+            if (_fault(S25FL_STAT2_E_ERR, HOST_T_CE_US))  break;
+            stats.erases++;
+            memset(chip->memory, 0xFF, memorySize);
+            _startBusy(HOST_T_CE_US);
+            break;
+
+        case S25FL_CMD_POWERDOWN:
+            chip->powerDown = true;
+            chip->standbyNs = nowNs + (uint64_t)HOST_T_DPD_US * 1000;
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief      Agrega los datos enviados por el driver al comando en curso.
+*/
+/**************************************************************************/
+static void _frameWrite(uint8_t *buffer, uint32_t len)
+{
+    uint32_t i;
+
+    for (i = 0; i < len && chip->frameLen < HOST_FRAME_MAX; i++)
+    {
+        chip->frame[chip->frameLen++] = buffer[i];
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief      Lee un byte de la memoria emulada. Los de la region que
+                modifica una operacion suspendida no son validos, como en
+                la memoria real, y se devuelve basura en su lugar.
+*/
+/**************************************************************************/
+static uint8_t _memoryRead(uint32_t address)
+{
+    if ((chip->status2 & (S25FL_STAT2_PS | S25FL_STAT2_ES)) &&
+        address - chip->opAddress < chip->opLen)
+    {
+        stats.suspendedReads++;
+        return HOST_SUSPEND_JUNK ^ (uint8_t)address;
+    }
+    return chip->memory[address];
+}
+
+/**************************************************************************/
+/*!
+    @brief      Genera los datos que la memoria devuelve para el comando en
+                curso.
+
+    @param[in]  lanes
+                Cantidad de lineas usadas por el driver para leer.
+*/
+/**************************************************************************/
+static void _frameRead(s25fl_lanes_t lanes, uint8_t *buffer, uint32_t len)
+{
+    uint32_t i, header, address, wrap;
+    s25fl_lanes_t dataLanes = S25FL_LANES_1;
+    uint32_t jedec = HOST_JEDEC_ID(memorySize);
+
+    if (chip->frameLen == 0 || chip->powerDown || nowNs < chip->standbyNs)
+    {
+        memset(buffer, 0xFF, len);
+        return;
+    }
+
+    if (_readCommand(chip->frame[0], &header, &dataLanes))
+    {
+        address = _frameAddress();
+
+        // La rafaga circular solo se aplica a Quad I/O Read: la lectura
+        // vuelve al comienzo de la linea alineada al llegar a su final
+        wrap = (chip->frame[0] == S25FL_CMD_FREADQUADIO || chip->frame[0] == S25FL_CMD_FREADQUADIO4) ? chip->wrap : 0;
+
+        if (lanes != dataLanes || _busy())
+        {
+            stats.laneErrors += (lanes != dataLanes);
+            memset(buffer, 0xFF, len);
+        }
+        else if (wrap)
+        {
+            for (i = 0; i < len; i++)
+            {
+                buffer[i] = _memoryRead((address - address % wrap) + (address % wrap + chip->readPos + i) % wrap);
+            }
+        }
+        else
+        {
+            for (i = 0; i < len; i++)
+            {
+                buffer[i] = _memoryRead((address + chip->readPos + i) % memorySize);
+            }
+        }
+        chip->readPos += len;
+        return;
+    }
+
+    for (i = 0; i < len; i++, chip->readPos++)
+    {
+        switch (chip->frame[0])
+        {
+            case S25FL_CMD_READSTAT1:
+                buffer[i] = chip->status1 | (_busy() ? SPIFLASH_STAT_BUSY : 0);
+                break;
+
+            case S25FL_CMD_READSTAT2:
+                buffer[i] = chip->status2;
+                break;
+
+            case S25FL_CMD_READCONFIG:
+                buffer[i] = chip->config1;
+                break;
+
+            case S25FL_CMD_READSFDP:
+                address = (((uint32_t)chip->frame[1] << 16) | ((uint32_t)chip->frame[2] << 8) | chip->frame[3]) + chip->readPos;
+                buffer[i] = (sfdp != NULL && address < sfdpLen) ? sfdp[address] : 0xFF;
+                break;
+
+            case S25FL_CMD_JEDECID:
+                buffer[i] = (chip->readPos < S25FL_ID_LEN) ? (jedec >> (8 * (S25FL_ID_LEN - 1 - chip->readPos))) & 0xFF : 0;
+                break;
+
+            default:
+                buffer[i] = 0xFF;
+                break;
+        }
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief      Codifica un tiempo tipico de la tabla SFDP: la cantidad de
+                unidades menos uno (5 bits) y la menor unidad que alcanza.
+*/
+/**************************************************************************/
+static uint32_t _sfdpTime(uint32_t us, const uint32_t *units)
+{
+    uint32_t unit, count;
+
+    for (unit = 0; unit < 3; unit++)
+    {
+        if ((us + units[unit] - 1) / units[unit] <= 32)    break;
+    }
+    count = (us + units[unit] - 1) / units[unit];
+    if (count > 32) count = 32;
+
+    return (count - 1) | (unit << 5);
+}
+
+/**************************************************************************/
+/*!
+    @brief      Arma la tabla SFDP de la S25FL-L del tamaño emulado, con los
+                mismos comandos, ciclos y tiempos que usa la memoria emulada.
+*/
+/**************************************************************************/
+static void _buildSfdp()
+{
+    static const uint32_t eraseUnits[] = { 1000, 16000, 128000, 1000000 };
+    static const uint32_t chipEraseUnits[] = { 16000, 256000, 4000000, 64000000 };
+    uint32_t bfpt[S25FL_SFDP_BFPT_DWORDS];
+    uint8_t i;
+
+    memset(bfpt, 0, sizeof(bfpt));
+
+    // 1-1-2, 1-2-2, 1-4-4 y 1-1-4, borrado de 4 KB y direcciones de 3 o 4 bytes
+    bfpt[0] = 0xFF800000 | (1UL << 22) | (1UL << 21) | (1UL << 20) | (1UL << 16) |
+              ((memorySize > (16UL << 20)) ? (1UL << 17) : 0) |
+              ((uint32_t)S25FL_CMD_SECTERASE4 << 8) | 0x04 | 0x01;
+    bfpt[1] = memorySize * 8 - 1;
+    bfpt[2] = (S25FL_QUADIO_DUMMY_CYCLES | (S25FL_QUADIO_MODE_CYCLES << 5) | (S25FL_CMD_FREADQUADIO << 8)) |
+              ((uint32_t)(S25FL_QUADOUT_DUMMY_CYCLES | (S25FL_CMD_FREADQUADOUT << 8)) << 16);
+    bfpt[3] = (S25FL_DUALOUT_DUMMY_CYCLES | (S25FL_CMD_FREADDUALOUT << 8)) |
+              ((uint32_t)(S25FL_DUALIO_DUMMY_CYCLES | (S25FL_DUALIO_MODE_CYCLES << 5) | (S25FL_CMD_FREADDUALIO << 8)) << 16);
+    bfpt[4] = 0xFFFFFFEE;       // Sin 2-2-2 ni 4-4-4
+    bfpt[5] = 0x0000FFFF;
+    bfpt[6] = 0x0000FFFF;
+
+    // Tipos de borrado: 4 KB, 32 KB y 64 KB, con maximos de 10 veces el tipico
+    bfpt[7] = 12 | (S25FL_CMD_SECTERASE4 << 8) | (15UL << 16) | ((uint32_t)S25FL_CMD_BLOCKERASE32 << 24);
+    bfpt[8] = 16 | (S25FL_CMD_BLOCKERASE64 << 8);
+    bfpt[9] = 4 | (_sfdpTime(HOST_T_SE_US, eraseUnits) << 4) | (_sfdpTime(HOST_T_BE32_US, eraseUnits) << 11) |
+              (_sfdpTime(HOST_T_BE64_US, eraseUnits) << 18);
+
+    // Pagina de 256 bytes, programacion en unidades de 64 us y borrado total
+    bfpt[10] = 1 | (8 << 4) | ((((HOST_T_PP_US + 63) / 64 - 1) | (1 << 5)) << 8) |
+               (_sfdpTime(HOST_T_CE_US, chipEraseUnits) << 24);
+
+    // Encabezado SFDP (revision 1.6, un encabezado de parametros) y el de la BFPT
+    memset(sfdpFixture, 0xFF, sizeof(sfdpFixture));
+    memcpy(sfdpFixture, "SFDP", 4);
+    sfdpFixture[4] = 0x06;
+    sfdpFixture[5] = 0x01;
+    sfdpFixture[6] = 0x00;
+    sfdpFixture[8] = S25FL_SFDP_BFPT_ID & 0xFF;
+    sfdpFixture[9] = 0x06;
+    sfdpFixture[10] = 0x01;
+    sfdpFixture[11] = S25FL_SFDP_BFPT_DWORDS;
+    sfdpFixture[12] = HOST_SFDP_BFPT;
+    sfdpFixture[13] = 0;
+    sfdpFixture[14] = 0;
+    sfdpFixture[15] = S25FL_SFDP_BFPT_ID >> 8;
+
+    for (i = 0; i < S25FL_SFDP_BFPT_DWORDS; i++)
+    {
+        sfdpFixture[HOST_SFDP_BFPT + 4*i]     = bfpt[i] & 0xFF;
+        sfdpFixture[HOST_SFDP_BFPT + 4*i + 1] = (bfpt[i] >> 8) & 0xFF;
+        sfdpFixture[HOST_SFDP_BFPT + 4*i + 2] = (bfpt[i] >> 16) & 0xFF;
+        sfdpFixture[HOST_SFDP_BFPT + 4*i + 3] = (bfpt[i] >> 24) & 0xFF;
+    }
+
+    sfdp = sfdpFixture;
+    sfdpLen = sizeof(sfdpFixture);
+}
+
+/**************************************************************************/
+/*!
+    @brief      Inicializa las memorias emuladas, completamente borradas.
+
+    @param[in]  size
+                Capacidad de cada memoria emulada en bytes.
+    @param[in]  lanes
+                Cantidad maxima de lineas de datos cableadas en el bus.
+    @return     True si se pudo reservar la memoria.
+*/
+/**************************************************************************/
+bool init_host_port(uint32_t size, s25fl_lanes_t lanes)
+{
+    uint8_t n;
+
+    maxLanes = lanes;
+    nowNs = 0;
+
+    for (n = 0; n < HOST_CHIPS; n++)
+    {
+        chip = &chips[n];
+        if (chip->imageMapped)  munmap(chip->memory, memorySize);
+        else                    free(chip->memory);
+        chip->imageMapped = false;
+        chip->memory = (uint8_t*)malloc(size);
+        if (chip->memory == NULL) return false;
+
+        memset(chip->memory, 0xFF, size);
+        chip->status1 = 0;
+        chip->status2 = 0;
+        chip->config1 = 0;
+        chip->busyStatus2 = 0;
+        chip->opLen = 0;
+        chip->lastResumeNs = 0;
+        chip->busyUntilNs = 0;
+        chip->powerDown = false;
+        chip->standbyNs = 0;
+        chip->fault = HOST_FAULT_NONE;
+        chip->faultSkip = 0;
+        chip->continuousOpcode = 0;
+        chip->wrap = 0;
+        chip->frameLen = 0;
+        chip->selected = false;
+    }
+    memset(&ssp, 0, sizeof(ssp));
+    memorySize = size;
+    chip = &chips[0];
+    _buildSfdp();
+    resetStats_host_port();
+
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Reemplaza la tabla SFDP que devuelven las memorias emuladas,
+                para probar el descubrimiento con otras memorias.
+
+    @param[in]  blob
+                La tabla completa, desde la firma "SFDP", o NULL para
+                emular una memoria sin tabla SFDP.
+    @param[in]  len
+                El tamaño de la tabla en bytes.
+*/
+/**************************************************************************/
+void sfdp_host_port(const uint8_t *blob, uint32_t len)
+{
+    sfdp = blob;
+    sfdpLen = (blob != NULL) ? len : 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Hace fallar la proxima programacion o borrado de una de las
+                memorias emuladas, para probar el manejo de errores.
+
+    @param[in]  n
+                El numero de memoria emulada (0 a HOST_CHIPS - 1).
+    @param[in]  fault
+                El tipo de falla a inyectar.
+*/
+/**************************************************************************/
+void fault_host_port(uint8_t n, host_fault_t fault)
+{
+    faultAfter_host_port(n, fault, 0);
+}
+
+/**************************************************************************/
+/*!
+    @brief      Hace fallar una programacion o borrado posterior de una de
+                las memorias emuladas, por ejemplo una pagina en medio de
+                S25FL_writeBuffer.
+
+    @param[in]  n
+                El numero de memoria emulada (0 a HOST_CHIPS - 1).
+    @param[in]  fault
+                El tipo de falla a inyectar.
+    @param[in]  skip
+                Las programaciones y borrados que se completan antes del
+                que falla.
+*/
+/**************************************************************************/
+void faultAfter_host_port(uint8_t n, host_fault_t fault, uint32_t skip)
+{
+    if (n >= HOST_CHIPS)    return;
+
+    chips[n].fault = fault;
+    chips[n].faultSkip = skip;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Usa un archivo como contenido de una de las memorias
+                emuladas, mapeandolo con mmap. Las programaciones y borrados
+                quedan en el archivo, y si es mas chico que la memoria se lo
+                extiende con 0xFF. Se debe llamar despues de init_host_port.
+
+    @param[in]  n
+                El numero de memoria emulada (0 a HOST_CHIPS - 1).
+    @param[in]  path
+                El archivo con la imagen de la memoria.
+    @return     True si se pudo mapear el archivo.
+*/
+/**************************************************************************/
+bool image_host_port(uint8_t n, const char *path)
+{
+    uint8_t *image;
+    off_t fileSize;
+    int fd;
+
+    if (n >= HOST_CHIPS || chips[n].memory == NULL) return false;
+
+    fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return false;
+
+    fileSize = lseek(fd, 0, SEEK_END);
+    if (fileSize < 0 || (fileSize < memorySize && ftruncate(fd, memorySize) != 0))
+    {
+        close(fd);
+        return false;
+    }
+
+    image = (uint8_t*)mmap(NULL, memorySize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED)    return false;
+
+    if (fileSize < memorySize)  memset(image + fileSize, 0xFF, memorySize - fileSize);
+
+    if (chips[n].imageMapped)   munmap(chips[n].memory, memorySize);
+    else                        free(chips[n].memory);
+    chips[n].memory = image;
+    chips[n].imageMapped = true;
+
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Obtiene los contadores de uso del bus emulado.
+*/
+/**************************************************************************/
+void getStats_host_port(host_port_stats_t *out)
+{
+    *out = stats;
+    out->timeNs = nowNs - statsStartNs;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Reinicia los contadores de uso del bus emulado.
+*/
+/**************************************************************************/
+void resetStats_host_port()
+{
+    memset(&stats, 0, sizeof(stats));
+    statsStartNs = nowNs;
+}
+
+/**************************************************************************/
+/*!
+    @param[in]  n
+                El numero de memoria emulada (0 a HOST_CHIPS - 1).
+    @return     Puntero al contenido de la memoria emulada.
+*/
+/**************************************************************************/
+uint8_t* memory_host_port(uint8_t n)
+{
+    return (n < HOST_CHIPS) ? chips[n].memory : NULL;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Devuelve un puntero de solo lectura a una region de la
+                memoria emulada, como lo haria un controlador mapeado en
+                memoria.
+*/
+/**************************************************************************/
+static const uint8_t* _map(uint8_t n, uint32_t address, uint32_t len)
+{
+    if (chips[n].memory == NULL || address >= memorySize || len > memorySize - address)   return NULL;
+
+    stats.mapped++;
+    return chips[n].memory + address;
+}
+
+const uint8_t* spiMap_host_port(uint32_t address, uint32_t len)
+{
+    return _map(0, address, len);
+}
+
+const uint8_t* spiMap2_host_port(uint32_t address, uint32_t len)
+{
+    return _map(1, address, len);
+}
+
+/**************************************************************************/
+/*!
+    @brief      Recibe el aviso de que se va a modificar una region. La vista
+                mapeada de la memoria emulada no tiene cache, por lo que
+                solo se la cuenta.
+*/
+/**************************************************************************/
+void spiMapInvalidate_host_port(uint32_t address, uint32_t len)
+{
+    (void)address;
+    (void)len;
+    stats.mapInvalidations++;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Selecciona o deselecciona una de las memorias del bus.
+*/
+/**************************************************************************/
+static void _chipSelect(uint8_t n, csState_t estado)
+{
+    if (estado == CS_ENABLE)
+    {
+        // Las dos memorias comparten el bus: ambas responderian en MISO
+        if (chips[1 - n].selected)  stats.busConflicts++;
+
+        chip = &chips[n];
+        chip->frameLen = 0;
+        chip->readPos = 0;
+        chip->selected = true;
+
+        // En lectura continua la memoria toma lo primero que recibe como
+        // la direccion de otra lectura con el mismo comando
+        if (chip->continuousOpcode && !chip->powerDown)
+        {
+            chip->frame[chip->frameLen++] = chip->continuousOpcode;
+            stats.continuousReads++;
+        }
+    }
+    else if (chips[n].selected)
+    {
+        chip = &chips[n];
+        _execute();
+        chip->selected = false;
+    }
+}
+
+/*************************************************************************************************
+	 *  @brief Funcion para set/reset del chip enable
+     *
+	 *  @param		estado	Determina la accion a ser tomada con el pin CS.
+***************************************************************************************************/
+void chipSelect_host_port(csState_t estado)
+{
+    _chipSelect(0, estado);
+}
+
+/*************************************************************************************************
+	 *  @brief Funcion para set/reset del chip enable de la segunda memoria del bus
+     *
+	 *  @param		estado	Determina la accion a ser tomada con el pin CS.
+***************************************************************************************************/
+void chipSelect2_host_port(csState_t estado)
+{
+    _chipSelect(1, estado);
+}
+
+/**************************************************************************/
+/*!
+    @brief      Lee datos de la memoria emulada por una sola linea.
+*/
+/**************************************************************************/
+unsigned char spiRead_host_port(uint8_t* buffer, uint32_t bufferSize)
+{
+    _frameRead(S25FL_LANES_1, buffer, bufferSize);
+    _busTransfer(bufferSize, S25FL_LANES_1);
+    return 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Intercambia un byte con la memoria emulada.
+*/
+/**************************************************************************/
+uint8_t spiReadRegister_host_port(uint8_t reg)
+{
+    uint8_t data;
+
+    _frameWrite(&reg, 1);
+    _frameRead(S25FL_LANES_1, &data, 1);
+    _busTransfer(1, S25FL_LANES_1);
+    return data;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Escribe un array de datos a la memoria emulada.
+*/
+/**************************************************************************/
+void spiWrite_host_port(uint8_t* buffer, uint32_t bufferSize)
+{
+    _frameWrite(buffer, bufferSize);
+    _busTransfer(bufferSize, S25FL_LANES_1);
+}
+
+/**************************************************************************/
+/*!
+    @brief      Escribe un byte a la memoria emulada.
+*/
+/**************************************************************************/
+void spiWriteByte_host_port(uint8_t data)
+{
+    _frameWrite(&data, 1);
+    _busTransfer(1, S25FL_LANES_1);
+}
+
+/**************************************************************************/
+/*!
+    @brief      Entrega la notificacion de fin de la transferencia en segundo
+                plano si ya paso su tiempo, como lo haria la interrupcion.
+*/
+/**************************************************************************/
+static void _asyncService()
+{
+    spiDone_t done = asyncDone;
+
+    if (done != NULL && nowNs >= asyncEndNs)
+    {
+        asyncDone = NULL;
+        done(asyncCtx);
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief      Avanza el tiempo emulado la cantidad de milisegundos pedida.
+*/
+/**************************************************************************/
+void delay_host_port(uint32_t millisecs)
+{
+    nowNs += (uint64_t)millisecs * 1000000;
+    _asyncService();
+}
+
+/**************************************************************************/
+/*!
+    @brief      Avanza el tiempo emulado la cantidad de microsegundos pedida.
+*/
+/**************************************************************************/
+void delayUs_host_port(uint32_t microsecs)
+{
+    nowNs += (uint64_t)microsecs * 1000;
+    _asyncService();
+}
+
+/**************************************************************************/
+/*!
+    @return     El tiempo emulado en microsegundos.
+*/
+/**************************************************************************/
+uint32_t timeUs_host_port()
+{
+    _asyncService();
+    return (uint32_t)(nowNs / 1000);
+}
+
+/**************************************************************************/
+/*!
+    @brief      Configura el clock del bus emulado.
+*/
+/**************************************************************************/
+void spiSetClock_host_port(s25fl_clock_t clock)
+{
+    switch (clock)
+    {
+        case S25FL_CLK_READ:    clockHz = HOST_SPI_CLK_READ;    break;
+        case S25FL_CLK_FAST:    clockHz = HOST_SPI_CLK_FAST;    break;
+        default:                clockHz = HOST_SPI_CLK_CONTROL; break;
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief      Transfiere datos por varias lineas. Si el bus no tiene la
+                cantidad de lineas pedida, o se usan 4 lineas sin el bit QE,
+                los datos se pierden y se cuenta un error.
+*/
+/**************************************************************************/
+void spiLanes_host_port(s25fl_lanes_t lanes, uint8_t *txBuffer, uint8_t *rxBuffer, uint32_t len)
+{
+    bool valid = (lanes <= maxLanes) &&
+                 (lanes != S25FL_LANES_4 || (chip->config1 & S25FL_CONFIG_QUAD));
+
+    if (!valid)
+    {
+        stats.laneErrors++;
+        if (rxBuffer != NULL)   memset(rxBuffer, 0xFF, len);
+    }
+    else if (txBuffer != NULL)
+    {
+        _frameWrite(txBuffer, len);
+    }
+    else
+    {
+        _frameRead(lanes, rxBuffer, len);
+    }
+
+    _busTransfer(len, lanes);
+}
+
+/**************************************************************************/
+/*!
+    @brief      Realiza una transaccion completa con un unico costo fijo, ya
+                que las fases se encadenan sin vaciar el FIFO. Se aplican
+                las mismas validaciones de lineas que en spiLanes_host_port.
+*/
+/**************************************************************************/
+bool spiTransfer_host_port(const s25fl_xfer_t *xfer)
+{
+    uint8_t header[1 + 4 + 1 + 8];
+    uint32_t n = 0, i, dummy, headerCycles;
+    uint32_t opcodeBytes = xfer->skipOpcode ? 0 : 1;
+    uint64_t cycles;
+    s25fl_lanes_t lanes = (xfer->addrLanes > xfer->dataLanes) ? xfer->addrLanes : xfer->dataLanes;
+    bool valid = (lanes <= maxLanes) &&
+                 (lanes != S25FL_LANES_4 || (chip->config1 & S25FL_CONFIG_QUAD));
+
+    if (opcodeBytes)    header[n++] = xfer->opcode;
+    for (i = xfer->addrBytes; i > 0; i--)
+    {
+        header[n++] = (xfer->address >> (8 * (i - 1))) & 0xFF;
+    }
+    if (xfer->modeCycles)   header[n++] = xfer->mode;
+    dummy = (xfer->dummyCycles * xfer->addrLanes) / 8;
+    for (i = 0; i < dummy; i++)
+    {
+        header[n++] = 0xFF;
+    }
+
+    _frameWrite(header, n);
+
+    if (!valid)
+    {
+        stats.laneErrors++;
+        if (xfer->rxData != NULL)   memset(xfer->rxData, 0xFF, xfer->len);
+    }
+    else if (xfer->txData != NULL)
+    {
+        _frameWrite(xfer->txData, xfer->len);
+    }
+    else if (xfer->rxData != NULL)
+    {
+        _frameRead(xfer->dataLanes, xfer->rxData, xfer->len);
+    }
+
+    // El comando (si no esta en lectura continua) va por una linea, la direccion, modo y latencia por las
+    // lineas de direccion y los datos por las lineas de datos
+    headerCycles = 8 * opcodeBytes + ((n - opcodeBytes) * 8) / xfer->addrLanes;
+    cycles = headerCycles + ((uint64_t)xfer->len * 8) / xfer->dataLanes;
+    stats.portCalls++;
+    stats.busCycles += cycles;
+    nowNs += HOST_CALL_OVERHEAD_NS + (cycles * 1000000000ULL) / clockHz;
+
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Emula una transferencia por DMA. El bus queda ocupado el
+                tiempo que tardaria la transferencia, sin consumir tiempo
+                del programa, y la notificacion se entrega desde delay,
+                delayUs o timeUs una vez transcurrido.
+
+    @return     False si ya hay una transferencia en curso.
+*/
+/**************************************************************************/
+bool spiAsync_host_port(uint8_t *txBuffer, uint8_t *rxBuffer, uint32_t len, spiDone_t done, void *ctx)
+{
+    uint64_t startNs = nowNs;
+
+    if (asyncDone != NULL)  return false;
+
+    // Los bytes 0xFF enviados durante una lectura no forman parte del comando
+    if (txBuffer != NULL)   _frameWrite(txBuffer, len);
+    if (rxBuffer != NULL)   _frameRead(S25FL_LANES_1, rxBuffer, len);
+
+    _busTransfer(len, S25FL_LANES_1);
+    stats.asyncTransfers++;
+
+    asyncEndNs = nowNs;
+    nowNs = startNs;
+    asyncDone = done;
+    asyncCtx = ctx;
+
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Intercambia un frame con la memoria seleccionada, al
+                terminar de desplazarlo. Los frames del encabezado y los de
+                datos enviados por el driver se agregan al comando; en la
+                fase de datos, si el driver los recibe, se genera la
+                respuesta de la memoria.
+*/
+/**************************************************************************/
+static uint8_t _sspExchange(uint8_t mosi)
+{
+    uint8_t miso = 0xFF;
+    bool data = ssp.frame >= ssp.headerLen;
+
+    ssp.frame++;
+    if (!data || ssp.txData)    _frameWrite(&mosi, 1);
+    if (data && ssp.rxData)     _frameRead(S25FL_LANES_1, &miso, 1);
+    return miso;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Avanza el SSP emulado hasta el tiempo actual: termina el
+                frame en desplazamiento y empieza el siguiente del FIFO de
+                transmision, contando el tiempo que la linea quedo sin
+                clock entre frames de la misma llamada.
+*/
+/**************************************************************************/
+static void _sspAdvance()
+{
+    uint64_t start;
+
+    for (;;)
+    {
+        if (ssp.shifting)
+        {
+            if (nowNs < ssp.shiftEndNs)     return;
+
+            if (ssp.rxCount == S25FL_SSP_FIFO_DEPTH)    stats.sspOverruns++;
+            else    ssp.rx[(ssp.rxHead + ssp.rxCount++) % S25FL_SSP_FIFO_DEPTH] = _sspExchange(ssp.shiftData);
+            ssp.shifting = false;
+            ssp.lineFreeNs = ssp.shiftEndNs;
+        }
+
+        if (ssp.txCount == 0)   return;
+
+        start = ssp.txReadyNs[ssp.txHead];
+        if (start < ssp.lineFreeNs)     start = ssp.lineFreeNs;
+        if (start > nowNs)              return;
+        if (ssp.frame > 0)              stats.sspGapNs += start - ssp.lineFreeNs;
+
+        ssp.shiftData = ssp.tx[ssp.txHead];
+        ssp.txHead = (ssp.txHead + 1) % S25FL_SSP_FIFO_DEPTH;
+        ssp.txCount--;
+        ssp.shifting = true;
+        ssp.shiftEndNs = start + (8 * 1000000000ULL) / clockHz;
+        stats.busCycles += 8;
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief      Lee el registro de estado del SSP emulado.
+*/
+/**************************************************************************/
+static uint32_t _sspStatus()
+{
+    nowNs += HOST_SSP_ACCESS_NS;
+    _sspAdvance();
+
+    return (ssp.txCount == 0 ? S25FL_SSP_STAT_TFE : 0) |
+           (ssp.txCount < S25FL_SSP_FIFO_DEPTH ? S25FL_SSP_STAT_TNF : 0) |
+           (ssp.rxCount > 0 ? S25FL_SSP_STAT_RNE : 0) |
+           (ssp.shifting || ssp.txCount > 0 ? S25FL_SSP_STAT_BSY : 0);
+}
+
+/**************************************************************************/
+/*!
+    @brief      Escribe un frame en el FIFO de transmision del SSP emulado.
+                Con el FIFO lleno el frame se pierde.
+*/
+/**************************************************************************/
+static void _sspWrite(uint8_t data)
+{
+    nowNs += HOST_SSP_ACCESS_NS;
+    _sspAdvance();
+
+    if (ssp.txCount == S25FL_SSP_FIFO_DEPTH)
+    {
+        stats.sspOverruns++;
+        return;
+    }
+    ssp.tx[(ssp.txHead + ssp.txCount) % S25FL_SSP_FIFO_DEPTH] = data;
+    ssp.txReadyNs[(ssp.txHead + ssp.txCount) % S25FL_SSP_FIFO_DEPTH] = nowNs;
+    ssp.txCount++;
+    _sspAdvance();
+}
+
+/**************************************************************************/
+/*!
+    @brief      Lee un frame del FIFO de recepcion del SSP emulado.
+*/
+/**************************************************************************/
+static uint8_t _sspRead()
+{
+    uint8_t data = 0;
+
+    nowNs += HOST_SSP_ACCESS_NS;
+    _sspAdvance();
+
+    if (ssp.rxCount > 0)
+    {
+        data = ssp.rx[ssp.rxHead];
+        ssp.rxHead = (ssp.rxHead + 1) % S25FL_SSP_FIFO_DEPTH;
+        ssp.rxCount--;
+    }
+    return data;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Transfiere por el SSP emulado con el nucleo del puerto de la
+                CIAA o, para comparar, frame a frame: se envia un frame y se
+                espera a recibirlo antes de enviar el siguiente.
+*/
+/**************************************************************************/
+static void _sspRun(const uint8_t *header, uint32_t headerLen, const uint8_t *txData, uint8_t *rxData, uint32_t len)
+{
+    uint32_t i;
+    uint8_t data;
+
+    ssp.frame = 0;
+    ssp.headerLen = headerLen;
+    ssp.txData = (txData != NULL);
+    ssp.rxData = (rxData != NULL);
+    stats.portCalls++;
+
+    if (sspPrimed)
+    {
+        _sspTransfer(header, headerLen, txData, rxData, len);
+        return;
+    }
+
+    for (i = 0; i < headerLen + len; i++)
+    {
+        if (i < headerLen)          data = header[i];
+        else if (txData != NULL)    data = txData[i - headerLen];
+        else                        data = 0xFF;
+        _sspWrite(data);
+
+        while (!(_sspStatus() & S25FL_SSP_STAT_RNE));
+        data = _sspRead();
+        if (i >= headerLen && rxData != NULL)   rxData[i - headerLen] = data;
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief      Elige como transfieren las funciones ssp*_host_port.
+
+    @param[in]  primed
+                True (por defecto) para el nucleo con el FIFO cargado del
+                puerto de la CIAA, false para transferir frame a frame.
+*/
+/**************************************************************************/
+void sspPrimed_host_port(bool primed)
+{
+    sspPrimed = primed;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Lee datos de la memoria emulada por el SSP emulado.
+*/
+/**************************************************************************/
+unsigned char sspRead_host_port(uint8_t* buffer, uint32_t bufferSize)
+{
+    _sspRun(NULL, 0, NULL, buffer, bufferSize);
+    return 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Intercambia un byte con la memoria emulada por el SSP emulado.
+*/
+/**************************************************************************/
+uint8_t sspReadRegister_host_port(uint8_t reg)
+{
+    uint8_t data;
+
+    _sspRun(NULL, 0, &reg, &data, 1);
+    return data;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Escribe un array de datos a la memoria emulada por el SSP
+                emulado.
+*/
+/**************************************************************************/
+void sspWrite_host_port(uint8_t* buffer, uint32_t bufferSize)
+{
+    _sspRun(NULL, 0, buffer, NULL, bufferSize);
+}
+
+/**************************************************************************/
+/*!
+    @brief      Escribe un byte a la memoria emulada por el SSP emulado.
+*/
+/**************************************************************************/
+void sspWriteByte_host_port(uint8_t data)
+{
+    _sspRun(NULL, 0, &data, NULL, 1);
+}
+
+/**************************************************************************/
+/*!
+    @brief      Realiza una transaccion completa por el SSP emulado, igual
+                que spiTransfer_CIAA_port.
+
+    @return     False si la transaccion usa mas de una linea.
+*/
+/**************************************************************************/
+bool sspTransfer_host_port(const s25fl_xfer_t *xfer)
+{
+    uint8_t header[1 + 4 + 1 + 8];
+    uint32_t n = 0, i;
+
+    if (xfer->addrLanes != S25FL_LANES_1 || xfer->dataLanes != S25FL_LANES_1)   return false;
+
+    if (!xfer->skipOpcode)  header[n++] = xfer->opcode;
+    for (i = xfer->addrBytes; i > 0; i--)
+    {
+        header[n++] = (xfer->address >> (8 * (i - 1))) & 0xFF;
+    }
+    if (xfer->modeCycles)   header[n++] = xfer->mode;
+    for (i = 0; i < xfer->dummyCycles / 8; i++)
+    {
+        header[n++] = 0xFF;
+    }
+
+    _sspRun(header, n, xfer->txData, xfer->rxData, xfer->len);
+    return true;
+}
+
+#endif // S25FL_HOST_PORT
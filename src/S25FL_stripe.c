@@ -0,0 +1,373 @@
+/*
+ *  S25FL_stripe.c
+ *
+ *  Created on: 17-09-2021
+ *  Author: Martin Rios - jrios@fi.uba.ar
+ *
+ */
+
+#include "S25FL_stripe.h"
+#include <stddef.h>
+
+static uint32_t _locate(s25fl_stripe_t *stripe, uint32_t address, uint8_t *chip, uint32_t *local);
+static uint32_t _localUnit(s25fl_stripe_t *stripe, uint8_t chip, uint32_t unit);
+static void _idle(s25fl_dev_t *dev, uint32_t us);
+static s25fl_dev_t* _select(s25fl_stripe_t *stripe, uint8_t chip);
+
+/**************************************************************************/
+/*!
+    @brief      Inicializa un dispositivo intercalado sobre una o dos
+                memorias ya inicializadas con S25FL_InitDriver.
+
+    @param[out] stripe
+                El dispositivo a inicializar.
+    @param[in]  chip0
+                La primera memoria, que guarda los sectores pares.
+    @param[in]  chip1
+                La segunda memoria, que guarda los sectores impares. Si es
+                NULL el dispositivo usa solo la primera memoria.
+    @return     False si las memorias no tienen la misma geometria. En ese
+                caso el dispositivo queda sin memorias (count en 0).
+*/
+/**************************************************************************/
+bool S25FL_stripeInit (s25fl_stripe_t *stripe, s25fl_dev_t *chip0, s25fl_dev_t *chip1)
+{
+    if (stripe == NULL) return false;
+
+    stripe->count = 0;
+    if (chip0 == NULL)  return false;
+    if (chip1 != NULL && chip1->totalsize != chip0->totalsize)  return false;
+    if (chip1 != NULL && S25FL_sectorSize(chip1) != S25FL_sectorSize(chip0))  return false;
+
+    stripe->chips[0] = chip0;
+    stripe->chips[1] = chip1;
+    stripe->count = (chip1 != NULL) ? 2 : 1;
+    stripe->unit = S25FL_sectorSize(chip0);
+    stripe->totalsize = chip0->totalsize * stripe->count;
+
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @return     El estado combinado de las memorias (ver S25FL_readStatus).
+*/
+/**************************************************************************/
+uint8_t S25FL_stripeStatus (s25fl_stripe_t *stripe)
+{
+    uint8_t c, status = 0;
+
+    for (c = 0; c < stripe->count; c++)
+    {
+        status |= S25FL_readStatus(_select(stripe, c));
+    }
+
+    return status;
+}
+
+/**************************************************************************/
+/*!
+    @return     La capacidad total del dispositivo en bytes.
+*/
+/**************************************************************************/
+uint32_t S25FL_stripeSize (s25fl_stripe_t *stripe)
+{
+    return stripe->totalsize;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Lee datos del dispositivo, que pueden abarcar varios sectores
+                de ambas memorias.
+
+    @param[in]  address
+                La direccion donde comenzara la lectura.
+    @param[out] buffer
+                El buffer donde se guardaran los datos leidos.
+    @param[in]  len
+                La cantidad de bytes a leer.
+    @return     La cantidad de bytes leidos.
+*/
+/**************************************************************************/
+uint32_t S25FL_stripeRead (s25fl_stripe_t *stripe, uint32_t address, uint8_t *buffer, uint32_t len)
+{
+    uint32_t done = 0, local, n;
+    uint8_t chip;
+
+    if (address >= stripe->totalsize)   return 0;
+    if (len > stripe->totalsize - address)  len = stripe->totalsize - address;
+
+    while (done < len)
+    {
+        n = _locate(stripe, address + done, &chip, &local);
+        if (n > len - done) n = len - done;
+
+        if (S25FL_readBuffer(_select(stripe, chip), local, buffer + done, n) != n) break;
+        done += n;
+    }
+
+    return done;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Lee datos del dispositivo y los entrega de a bloques a un
+                consumidor (ver S25FL_readStream), con una lectura continua
+                por cada sector de cada memoria, o una sola si se usa una
+                memoria.
+
+    @param[in]  address
+                La direccion donde comenzara la lectura.
+    @param[in]  len
+                La cantidad de bytes a leer.
+    @param[in]  consumer
+                La funcion que recibe cada bloque. Si devuelve false se
+                termina la lectura.
+    @param[in]  ctx
+                Contexto para el consumidor.
+    @return     La cantidad de bytes entregados al consumidor.
+*/
+/**************************************************************************/
+uint32_t S25FL_stripeReadStream (s25fl_stripe_t *stripe, uint32_t address, uint32_t len, s25flStream_t consumer, void *ctx)
+{
+    uint32_t done = 0, local, n, got;
+    uint8_t chip;
+
+    if (address >= stripe->totalsize)   return 0;
+    if (len > stripe->totalsize - address)  len = stripe->totalsize - address;
+
+    while (done < len)
+    {
+        // Con una sola memoria los sectores son contiguos y se leen de una vez
+        n = _locate(stripe, address + done, &chip, &local);
+        if (stripe->count == 1 || n > len - done) n = len - done;
+
+        got = S25FL_readStream(_select(stripe, chip), local, n, consumer, ctx);
+        done += got;
+        if (got != n)   break;
+    }
+
+    return done;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Borra un rango del dispositivo.
+
+    Los sectores de un rango contiguo quedan contiguos dentro de cada
+    memoria, por lo que se inicia un borrado no bloqueante en cada una y
+    ambas borran al mismo tiempo, usando bloques de 32 y 64 KB cuando
+    el rango lo permite.
+
+    @param[in]  address
+                La direccion de comienzo, alineada a un sector.
+    @param[in]  length
+                La cantidad de bytes a borrar, multiplo del sector.
+    @return     True si se borro todo el rango.
+*/
+/**************************************************************************/
+bool S25FL_stripeErase (s25fl_stripe_t *stripe, uint32_t address, uint32_t length)
+{
+    s25fl_handle_t handles[S25FL_STRIPE_CHIPS];
+    uint32_t first, last, interval;
+    uint8_t c;
+    bool running, ok = true;
+
+    if ((address % stripe->unit) || (length % stripe->unit))  return false;
+    if (address >= stripe->totalsize || length > stripe->totalsize - address)   return false;
+
+    for (c = 0; c < stripe->count; c++)
+    {
+        handles[c].state = S25FL_HANDLE_DONE;
+
+        first = _localUnit(stripe, c, address / stripe->unit);
+        last = _localUnit(stripe, c, (address + length) / stripe->unit);
+        if (last == first)  continue;
+
+        if (S25FL_startErase(_select(stripe, c), &handles[c], first * stripe->unit,
+                             (last - first) * stripe->unit, NULL, NULL) != S25FL_OK)
+        {
+            ok = false;
+        }
+    }
+
+    // Se consulta cada memoria a intervalos cortos respecto al borrado de un sector
+    interval = S25FL_profile(stripe->chips[0])->timings[S25FL_OP_ERASE_4K].typical / S25FL_POLL_DIVIDER;
+    do
+    {
+        running = false;
+        for (c = 0; c < stripe->count; c++)
+        {
+            if (S25FL_poll(_select(stripe, c), &handles[c]) == S25FL_HANDLE_RUNNING) running = true;
+            else if (handles[c].state == S25FL_HANDLE_ERROR)    ok = false;
+        }
+        if (running)    _idle(stripe->chips[0], interval);
+    } while (running);
+
+    return ok;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Escribe datos en el dispositivo, que pueden abarcar varios
+                sectores de ambas memorias.
+
+    Se recorre el rango por filas (un sector de cada memoria) y dentro de
+    cada fila se envian las paginas alternando entre las memorias sin
+    esperar a que terminen, de modo que una memoria programa mientras se
+    le envian los datos a la otra. Al final se espera a ambas.
+
+    @note       Antes de escribir los datos, asegurarse que los sectores
+                correspondientes han sido borrados.
+
+    @param[in]  address
+                La direccion donde comenzara la escritura.
+    @param[in]  buffer
+                Los datos a escribir.
+    @param[in]  len
+                La cantidad de bytes a escribir.
+    @return     La cantidad de bytes escritos. Si ocurrio un error se
+                devuelven los bytes de las filas completas, y si falla la
+                espera final o la verificacion por relectura, 0.
+*/
+/**************************************************************************/
+uint32_t S25FL_stripeWrite (s25fl_stripe_t *stripe, uint32_t address, uint8_t *buffer, uint32_t len)
+{
+    uint32_t pos[S25FL_STRIPE_CHIPS], end[S25FL_STRIPE_CHIPS];
+    uint32_t rowSize = stripe->unit * stripe->count;
+    uint32_t written = 0, rowStart, rowEnd, local, n, pagesize, verified;
+    uint8_t c, chip;
+    bool pending, ok = true;
+
+    if (address >= stripe->totalsize || len > stripe->totalsize - address)  return 0;
+
+    while (ok && written < len)
+    {
+        rowStart = address + written - ((address + written) % rowSize);
+        rowEnd = rowStart + rowSize;
+        if (rowEnd > address + len) rowEnd = address + len;
+
+        // Parte de la fila que corresponde a cada memoria
+        for (c = 0; c < stripe->count; c++)
+        {
+            pos[c] = rowStart + c * stripe->unit;
+            end[c] = pos[c] + stripe->unit;
+            if (pos[c] < address + written)   pos[c] = address + written;
+            if (end[c] > rowEnd)    end[c] = rowEnd;
+        }
+
+        // Se envian las paginas alternando entre las memorias
+        do
+        {
+            pending = false;
+            for (c = 0; ok && c < stripe->count; c++)
+            {
+                if (pos[c] >= end[c])   continue;
+
+                _locate(stripe, pos[c], &chip, &local);
+                pagesize = S25FL_pageSize(stripe->chips[chip]);
+                n = pagesize - (local % pagesize);
+                if (n > end[c] - pos[c])    n = end[c] - pos[c];
+
+                if (S25FL_writePage(_select(stripe, chip), local, buffer + (pos[c] - address), n, true) != n)
+                {
+                    ok = false;
+                    break;
+                }
+
+                pos[c] += n;
+                if (pos[c] < end[c])    pending = true;
+            }
+        } while (ok && pending);
+
+        if (ok) written = rowEnd - address;
+    }
+
+    // Se espera a que terminen las ultimas paginas
+    for (c = 0; c < stripe->count; c++)
+    {
+        if (S25FL_waitForOperation(_select(stripe, c)))   return 0;
+    }
+
+    // Con la politica de relectura se verifica lo escrito en cada memoria
+    if (stripe->chips[0]->config.verify == S25FL_VERIFY_READBACK)
+    {
+        for (verified = address; verified < address + written; verified += n)
+        {
+            n = _locate(stripe, verified, &chip, &local);
+            if (n > address + written - verified)   n = address + written - verified;
+            if (!S25FL_verify(_select(stripe, chip), local, buffer + (verified - address), n))  return 0;
+        }
+    }
+
+    return written;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Obtiene la memoria y la direccion dentro de ella que
+                corresponden a una direccion del dispositivo.
+
+    @param[in]  address
+                La direccion del dispositivo.
+    @param[out] chip
+                El indice de la memoria.
+    @param[out] local
+                La direccion dentro de la memoria.
+    @return     Los bytes que quedan hasta el final del sector, que estan
+                contiguos en la misma memoria.
+*/
+/**************************************************************************/
+static uint32_t _locate(s25fl_stripe_t *stripe, uint32_t address, uint8_t *chip, uint32_t *local)
+{
+    uint32_t unit = address / stripe->unit;
+    uint32_t offset = address % stripe->unit;
+
+    *chip = unit % stripe->count;
+    *local = (unit / stripe->count) * stripe->unit + offset;
+
+    return stripe->unit - offset;
+}
+
+/**************************************************************************/
+/*!
+    @return     La cantidad de sectores de la memoria indicada que estan
+                antes del sector del dispositivo unit.
+*/
+/**************************************************************************/
+static uint32_t _localUnit(s25fl_stripe_t *stripe, uint8_t chip, uint32_t unit)
+{
+    return (unit + stripe->count - 1 - chip) / stripe->count;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Espera sin usar el bus, con las funciones de delay del puerto.
+*/
+/**************************************************************************/
+static void _idle(s25fl_dev_t *dev, uint32_t us)
+{
+    if (dev->config.delay_us_fnc != NULL)   dev->config.delay_us_fnc(us);
+    else dev->config.delay_fnc((us + 999) / 1000);
+}
+
+/**************************************************************************/
+/*!
+    @brief      Libera el bus de las otras memorias antes de usar una: una
+                lectura puede dejar CS activo con el resto de una linea de
+                la cache pendiente (ver S25FL_releaseBus).
+
+    @return     La memoria indicada.
+*/
+/**************************************************************************/
+static s25fl_dev_t* _select(s25fl_stripe_t *stripe, uint8_t chip)
+{
+    uint8_t c;
+
+    for (c = 0; c < stripe->count; c++)
+    {
+        if (c != chip)  S25FL_releaseBus(stripe->chips[c]);
+    }
+
+    return stripe->chips[chip];
+}
@@ -3,10 +3,24 @@
 #include <stdlib.h>
 #include <string.h>
 
+// Dispositivo donde esta el sistema de archivos, una memoria o dos intercaladas
+static s25fl_stripe_t *disk = NULL;
+
+// Forma de actualizar la flash segun los datos que ya tiene
+typedef enum
+{
+    FS_WRITE_SKIP,          // Los datos son identicos, no se escribe nada
+    FS_WRITE_PROGRAM,       // Solo hay bits que pasan de 1 a 0, se programa sin borrar
+    FS_WRITE_ERASE,         // Algun bit pasa de 0 a 1, hay que borrar y reprogramar
+} fs_write_path_t;
+
+static bool _writeSpan(uint8_t *sectorBuffer, uint32_t address, const uint8_t *data, uint32_t len);
+static fs_write_path_t _writePath(const uint8_t *flash, const uint8_t *data, uint32_t len);
+static bool _programChanged(uint32_t address, uint8_t *flash, const uint8_t *data, uint32_t len);
 static uint32_t _fatSectorCount();
 static uint32_t _fatSectorAddress(uint32_t sector);
+static uint32_t _flashSectorSize();
 static uint32_t _flashSectorBase(uint32_t address);
-static uint32_t _flashSectorOffset(uint32_t address);
 
 /**************************************************************************/
 /*! 
@@ -14,12 +28,18 @@ static uint32_t _flashSectorOffset(uint32_t address);
 
     @param[in]  _fatFs
                 Puntero a la estructura del sistema de archivos.
+    @param[in]  stripe
+                El dispositivo donde esta el sistema de archivos, ya
+                inicializado con S25FL_stripeInit.
     @return     True si pudo montar correctamente el sistema de archivos.
 */
 /**************************************************************************/
-bool S25FL_begin(FATFS *_fatFs)
+bool S25FL_begin(FATFS *_fatFs, s25fl_stripe_t *stripe)
 {
-    FRESULT r = f_mount(_fatFs, MOUNT_POINT, 1);  // Se monta el sistema de archivos
+    FRESULT r;
+
+    disk = stripe;
+    r = f_mount(_fatFs, MOUNT_POINT, 1);  // Se monta el sistema de archivos
     if (r != FR_OK)
     {
         return false;
@@ -60,7 +80,7 @@ int S25FL_format(FATFS *_fatFs)
     }
 
     // Se comprueba que el sistema de archivos se puede montar
-    if (!S25FL_begin(_fatFs))
+    if (!S25FL_begin(_fatFs, disk))
     {
         return -1;
     }
@@ -70,27 +90,34 @@ int S25FL_format(FATFS *_fatFs)
 
 /**************************************************************************/
 /*! 
-    @brief      Inicializa el dispositivo de almacenamiento.
+    @brief      Inicializa el dispositivo de almacenamiento. Las memorias
+                ya se inicializaron antes de S25FL_begin, por lo que solo
+                se informa su estado.
 
-    @return     Siempre 0 ya que se va a usar un solo dispositivo.
+    @return     Estado del dispositivo (ver S25FL_FatFs_DiskStatus).
 */
 /**************************************************************************/
 DSTATUS S25FL_FatFs_DiskInitialize ( void )
 {
-    return 0;
+    return S25FL_FatFs_DiskStatus();
 }
 
 
 /**************************************************************************/
 /*! 
-    @brief      Obtiene el estado actual del dispositivo.
+    @brief      Obtiene el estado actual del dispositivo. Una memoria
+                ocupada programando o borrando no es un estado de FatFs: el
+                driver la espera antes del proximo acceso.
 
-    @return     Estado del dispositivo.
+    @return     0 si el dispositivo esta listo, STA_NOINIT si no se monto o
+                si fallo S25FL_stripeInit.
 */
 /**************************************************************************/
 DSTATUS S25FL_FatFs_DiskStatus ( void )
 {
-    return(S25FL_readStatus());
+    if (disk == NULL || disk->count == 0)   return STA_NOINIT;
+
+    return 0;
 }
 
 /**************************************************************************/
@@ -112,7 +139,7 @@ DRESULT S25FL_FatFs_DiskRead (BYTE *buff, DWORD sector, UINT count)
     // Se convierte el numero de sector del sistema FAT al correspondiente de la flash
     // y luego se leen la cantidad de sectores en el buffer provisto
     uint32_t address = _fatSectorAddress(sector);
-    if (S25FL_readBuffer(address, buff, count*FAT_SECTOR_SIZE) <= 0)
+    if (S25FL_stripeRead(disk, address, buff, count*FAT_SECTOR_SIZE) <= 0)
     {
         return RES_ERROR;
     }
@@ -136,7 +163,8 @@ DRESULT S25FL_FatFs_DiskRead (BYTE *buff, DWORD sector, UINT count)
 DRESULT S25FL_FatFs_DiskWrite (const BYTE *buff, DWORD sector, UINT count)
 {
     uint8_t *_flashSectorBuffer;
-    _flashSectorBuffer = (uint8_t*)malloc(FLASH_SECTOR_SIZE);
+    uint32_t rowSize = _flashSectorSize() * disk->count;
+    _flashSectorBuffer = (uint8_t*)malloc(rowSize);
 
     if (_flashSectorBuffer == NULL) {
         return RES_ERROR;
@@ -146,54 +174,164 @@ DRESULT S25FL_FatFs_DiskWrite (const BYTE *buff, DWORD sector, UINT count)
     // Se trata de hacer una iteracion inteligente, minimizando la cantidad
     // de escrituras en los sectores de la flash, al combinar varias escrituras
     // en sectores FAT contiguos en un solo ciclo de escritura/actualizacion
-    // del loop.
-    for (int i=0; i < count; )
+    // del loop. Con dos memorias se actualiza hasta una fila (un sector de
+    // cada memoria) por ciclo, para que ambas borren y programen a la vez.
+    for (UINT i=0; i < count; )
     {
         // Se determina la direccion de inicio de la flash correspondiente a este sector FAT  
         uint32_t address = _fatSectorAddress(sector+i);
-        uint32_t sectorStart = _flashSectorBase(address);
+        uint32_t rowEnd = address - (address % rowSize) + rowSize;
 
-        // Se calculan cuantos sectores FAT pueden ser escritos en este sector de la flash
-        int available = ((sectorStart + FLASH_SECTOR_SIZE) - address)/FAT_SECTOR_SIZE;
+        // Se determinan la cantidad de sectores FAT a escribir en esta fila,
+        // basado en la cantidad que quedan para escribir
+        UINT countToWrite = MIN(count-i, (rowEnd - address)/FAT_SECTOR_SIZE);
 
-        // Se determinan la cantidad de sectores FAT a escribir para llenar el
-        // sector de la flash, basado en la cantidad que quedan para escribir
-        int countToWrite = MIN(count-i, available);
-
-        // Se lee el sector entero y se lo guarda en RAM
-        if (S25FL_readBuffer(sectorStart, _flashSectorBuffer, FLASH_SECTOR_SIZE) != FLASH_SECTOR_SIZE)
+        // Se actualizan los sectores flash afectados
+        if (!_writeSpan(_flashSectorBuffer, address, buff+(i*FAT_SECTOR_SIZE), countToWrite*FAT_SECTOR_SIZE))
         {
-            // Error, no se pudo leer el sector antes de realizar la escritura
+            // Error, no se pudo leer, borrar o escribir la flash
+            free(_flashSectorBuffer);
             return RES_ERROR;
         }
 
-        // Se modifica la parte del sector apropiada con el nuevo bloque de datos
-        uint16_t blockOffset = _flashSectorOffset(address);
-        memcpy(_flashSectorBuffer+blockOffset, buff+(i*FAT_SECTOR_SIZE), countToWrite*FAT_SECTOR_SIZE);
+        // Se incrementa el contador de acuerdo a la cantidad de sectores FAT que fueron escritos
+        i += countToWrite;
+    }
+
+    free(_flashSectorBuffer);  // Se libera la memoria tomada para el buffer del sector
+    
+    return RES_OK;
+}
 
-        // Se borra el sector.
-        // El numero de sector a borrar se determina tomando la direccion base de
-        // inicio de ese sector y se la divide por el tamaño del sector.
-        if (!S25FL_eraseSector(sectorStart/FLASH_SECTOR_SIZE))
+/**************************************************************************/
+/*! 
+    @brief      Escribe sectores FAT contiguos dentro de una fila, evitando
+                el borrado siempre que se pueda.
+
+    Primero se leen solo los sectores FAT a escribir y se los compara con
+    los datos nuevos. Si son identicos no se escribe nada, y si solo hay
+    bits que pasan de 1 a 0 se programan las paginas que cambiaron, ya que
+    la NOR puede hacerlo sin borrar. Solo si algun bit debe volver a 1 se
+    leen los sectores flash enteros, se los borra y se los reprograma.
+
+    @param[in]  sectorBuffer
+                Buffer de trabajo del tamaño de una fila.
+    @param[in]  address
+                La direccion del primer sector FAT.
+    @param[in]  data
+                Los datos nuevos.
+    @param[in]  len
+                La cantidad de bytes a escribir, sin salir de la fila.
+    @return     True si se actualizo la flash.
+*/
+/**************************************************************************/
+static bool _writeSpan(uint8_t *sectorBuffer, uint32_t address, const uint8_t *data, uint32_t len)
+{
+    // Sectores de la flash afectados por la escritura
+    uint32_t spanStart = _flashSectorBase(address);
+    uint32_t spanEnd = _flashSectorBase(address + len - 1) + _flashSectorSize();
+    uint32_t spanLen = spanEnd - spanStart;
+    uint32_t head = address - spanStart;
+    uint32_t tail = spanEnd - (address + len);
+    uint8_t *flash = sectorBuffer + head;
+
+    // Se leen los datos actuales de los sectores FAT a escribir
+    if (S25FL_stripeRead(disk, address, flash, len) != len)  return false;
+
+    switch (_writePath(flash, data, len))
+    {
+        case FS_WRITE_SKIP:
+            return true;
+
+        case FS_WRITE_PROGRAM:
+            return _programChanged(address, flash, data, len);
+
+        case FS_WRITE_ERASE:
+        default:
+            break;
+    }
+
+    // Se lee el resto de los sectores enteros y se los guarda en RAM
+    if (head && S25FL_stripeRead(disk, spanStart, sectorBuffer, head) != head)  return false;
+    if (tail && S25FL_stripeRead(disk, address + len, flash + len, tail) != tail)   return false;
+
+    // Se modifica la parte apropiada con el nuevo bloque de datos
+    memcpy(flash, data, len);
+
+    // Se borran los sectores
+    if (!S25FL_stripeErase(disk, spanStart, spanLen))   return false;
+
+    // Se escriben los sectores en la flash con los datos actualizados
+    return S25FL_stripeWrite(disk, spanStart, sectorBuffer, spanLen) == spanLen;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Compara los datos nuevos con los que tiene la flash para
+                elegir como actualizarla.
+
+    @param[in]  flash
+                Los datos actuales de la flash.
+    @param[in]  data
+                Los datos nuevos.
+    @param[in]  len
+                La cantidad de bytes a comparar.
+    @return     La forma de actualizar la flash.
+*/
+/**************************************************************************/
+static fs_write_path_t _writePath(const uint8_t *flash, const uint8_t *data, uint32_t len)
+{
+    fs_write_path_t path = FS_WRITE_SKIP;
+    uint32_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        // Un bit en 1 sobre un 0 de la flash solo se logra borrando
+        if (data[i] & ~flash[i])    return FS_WRITE_ERASE;
+        if (data[i] != flash[i])    path = FS_WRITE_PROGRAM;
+    }
+
+    return path;
+}
+
+/**************************************************************************/
+/*! 
+    @brief      Programa sin borrar las paginas que cambiaron, agrupando las
+                consecutivas en una sola escritura.
+
+    @param[in]  address
+                La direccion de la flash donde comienzan los datos.
+    @param[in]  flash
+                Los datos actuales de la flash, que se actualizan con los
+                de las paginas programadas.
+    @param[in]  data
+                Los datos nuevos, que solo pasan bits de 1 a 0.
+    @param[in]  len
+                La cantidad de bytes, multiplo del tamaño de pagina.
+    @return     True si se programaron todas las paginas.
+*/
+/**************************************************************************/
+static bool _programChanged(uint32_t address, uint8_t *flash, const uint8_t *data, uint32_t len)
+{
+    uint32_t pagesize = S25FL_pageSize(disk->chips[0]);
+    uint32_t offset, runStart = 0, runLen = 0;
+
+    for (offset = 0; offset <= len; offset += pagesize)
+    {
+        if (offset < len && memcmp(flash + offset, data + offset, pagesize) != 0)
         {
-            // Error, no se pudo borrar el sector.
-            return RES_ERROR;
+            memcpy(flash + offset, data + offset, pagesize);
+            if (runLen == 0)    runStart = offset;
+            runLen += pagesize;
         }
-
-        // Se escrite el sector en la flash con los datos actualizados
-        if (S25FL_writeBuffer(sectorStart, _flashSectorBuffer, FLASH_SECTOR_SIZE) != FLASH_SECTOR_SIZE)
+        else if (runLen)
         {
-            // Error, no se pudo escribir el sector
-            return RES_ERROR;
+            if (S25FL_stripeWrite(disk, address + runStart, flash + runStart, runLen) != runLen)  return false;
+            runLen = 0;
         }
-
-        // Se incrementa el contador de acuerdo a la cantidad de sectores FAT que fueron escritos
-        i += countToWrite;
     }
 
-    if (_flashSectorBuffer != NULL) free(_flashSectorBuffer);  // Se libera la memoria tomada para el buffer del sector
-    
-    return RES_OK;
+    return true;
 }
 
 /**************************************************************************/
@@ -235,7 +373,7 @@ DRESULT S25FL_FatFs_DiskIoCtl (BYTE cmd, void *buff)
             // Devuelve el numero de sectores FAT por cada sector flash
             // Se utiliza para alinear los datos para un borrado eficiente
             DWORD* count = (DWORD*)buff;
-            *count = FLASH_SECTOR_SIZE/FAT_SECTOR_SIZE;
+            *count = _flashSectorSize()/FAT_SECTOR_SIZE;
             break;
         }
         case CTRL_TRIM:
@@ -254,7 +392,7 @@ DRESULT S25FL_FatFs_DiskIoCtl (BYTE cmd, void *buff)
 /**************************************************************************/
 static uint32_t _fatSectorCount()
 {
-    return (S25FL_pageSize()*S25FL_numPages())/FAT_SECTOR_SIZE;
+    return S25FL_stripeSize(disk)/FAT_SECTOR_SIZE;
 }
 
 /**************************************************************************/
@@ -284,24 +422,18 @@ static uint32_t _fatSectorAddress(uint32_t sector)
 /**************************************************************************/
 static uint32_t _flashSectorBase(uint32_t address)
 {
-    // Los 12 bits superiores de la direccion dan la direccion de comienzo
-    // del sector.
-    return address & 0xFFF000;
+    return address - (address % _flashSectorSize());
 }
 
 /**************************************************************************/
 /*! 
-    @brief      Obtiene el corrimiento en bytes respecto a la direccion de
-                comienzo del sector para direccion especificada.
+    @brief      Obtiene el tamaño del sector flash, que sale del perfil de la
+                memoria y es tambien la unidad de intercalado del dispositivo.
 
-    @param[in]  address
-                La direccion en memoria flash.
-    @return     El corrimiento en bytes.
+    @return     El tamaño del sector flash en bytes.
 */
 /**************************************************************************/
-static uint32_t _flashSectorOffset(uint32_t address)
+static uint32_t _flashSectorSize()
 {
-    // Los 12 bits inferiores de la direccion dan el offset respecto al
-    // inicio del sector.
-    return address & 0x000FFF;
+    return S25FL_sectorSize(disk->chips[0]);
 }
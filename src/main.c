@@ -17,13 +17,21 @@ void initHW ();
 FRESULT scan_files (char* path);
 static void showMainMenu();
 static void showMenu(const char *menuText, const char *menuFooter, const char **options, uint8_t nrOptions);
+static UINT forwardToUart(const BYTE *data, UINT len);
 
 static FATFS fatFs;
 static FIL fp;             // <-- File object needed for each open file
 
+static s25fl_dev_t flash;
+#if MEMORY_STRIPED
+static s25fl_dev_t flash2;
+#endif
+static s25fl_stripe_t flashDisk;
+
 int main (void)  
 {
-    s25fl_t s25flDriverStruct;
+    s25fl_t s25flDriverStruct = {0};   // Los campos opcionales no asignados quedan en NULL/0
+    bool driverOk;
     uint8_t i;
     UINT wbytes, br;
     TCHAR fpath[32];
@@ -44,12 +52,30 @@ int main (void)
     s25flDriverStruct.spi_read_fnc = spiRead_CIAA_port;
     s25flDriverStruct.spi_read_register = spiReadRegister_CIAA_port;
     s25flDriverStruct.delay_fnc = delay_CIAA_port;
+    s25flDriverStruct.delay_us_fnc = delayUs_CIAA_port;
+    s25flDriverStruct.time_us_fnc = timeUs_CIAA_port;
+    s25flDriverStruct.spi_set_clock = spiSetClock_CIAA_port;
+    s25flDriverStruct.spi_async_fnc = spiAsync_CIAA_port;
+    s25flDriverStruct.spi_transfer_fnc = spiTransfer_CIAA_port;
     s25flDriverStruct.memory_size = S64MB;
+    s25flDriverStruct.read_mode = S25FL_READ_AUTO;     // Con una sola linea cableada elige Fast Read
+    s25flDriverStruct.verify = S25FL_VERIFY_SR2;
+    s25flDriverStruct.idle_powerdown_us = MEMORY_IDLE_US;
 
     UART_clearTerminal();
     UART_cursorHome();
 
-    if(S25FL_InitDriver(s25flDriverStruct))
+    driverOk = S25FL_InitDriver(&flash, s25flDriverStruct);
+#if MEMORY_STRIPED
+    // La segunda memoria comparte el bus y solo cambia el CS
+    s25flDriverStruct.chip_select_ctrl = chipSelect2_CIAA_port;
+    driverOk = driverOk && S25FL_InitDriver(&flash2, s25flDriverStruct);
+    driverOk = driverOk && S25FL_stripeInit(&flashDisk, &flash, &flash2);
+#else
+    driverOk = driverOk && S25FL_stripeInit(&flashDisk, &flash, NULL);
+#endif
+
+    if(driverOk)
         UART_WriteLine("Driver inicializado."); 
     else
     {
@@ -59,10 +85,16 @@ int main (void)
 
     while(1)
     {
+        // Sin accesos durante MEMORY_IDLE_US las memorias entran en deep power-down
+        S25FL_idleTask(&flash);
+#if MEMORY_STRIPED
+        S25FL_idleTask(&flash2);
+#endif
+
         switch(stateMenu)
         {
             case START: // Estado inicial
-                if(S25FL_begin(&fatFs))
+                if(S25FL_begin(&fatFs, &flashDisk))
                 {
                     UART_WriteLine("Sistema de archivos inicializado.");
                     delay(2000);
@@ -80,6 +112,12 @@ int main (void)
             case MAIN_MENU: // Menu principal
                 if(UART_Available())
                 {
+                    // Casi todas las opciones usan la memoria: se la despierta
+                    // mientras se procesa la opcion
+                    S25FL_wakeHint(&flash);
+#if MEMORY_STRIPED
+                    S25FL_wakeHint(&flash2);
+#endif
                     menuOption = UART_readOption();
                     sprintf(outputLine, "%d\r\n", menuOption);
 
@@ -111,11 +149,9 @@ int main (void)
                             {
                                 UART_setCursorPosition(OPTIONS_START_Y_POS+3,OPTIONS_START_X_POS);
                                 UART_WriteLine("********** Contenido del archivo: **********");
-                                while (!f_eof( &fp ) ) 
+                                // Los datos pasan del buffer de FatFs a la UART sin copias intermedias
+                                if (f_forward( &fp, forwardToUart, f_size(&fp), &br ) == FR_OK && br > 0)
                                 {
-                                    int rbytes;                                    
-                                    f_read ( &fp , inputText, MAX_INPUT_TEXT, &rbytes);
-                                    UART_Write(inputText);
                                     gpioWrite( LEDG, ON );
                                 }
                                 UART_WriteLine("********************************************");
@@ -308,8 +344,13 @@ void initHW ()
 {
     UART_Init(UART_USB);
     if(spiInit(SPI0))   uartWriteString(UART_USB, "Spi inicializado correctamente.\r\n");
+    spiDmaInit_CIAA_port();
     gpioInit( MEMORY_CS, GPIO_OUTPUT );
     gpioWrite(MEMORY_CS, HIGH);
+#if MEMORY_STRIPED
+    gpioInit( MEMORY2_CS, GPIO_OUTPUT );
+    gpioWrite(MEMORY2_CS, HIGH);
+#endif
 }
 
 /**************************************************************************/
@@ -390,4 +431,21 @@ static void showMenu(const char *menuText, const char *menuFooter, const char **
 	UART_WriteLine("");
 	UART_WriteLine(menuHeader);
 	if(menuFooter != NULL) UART_Write(menuFooter);
-}
\ No newline at end of file
+}
+
+/**************************************************************************/
+/*!
+ * @brief   Recibe los datos del archivo desde f_forward y los envia a la UART
+
+ * @param   data Los datos a enviar, o NULL para consultar si se puede enviar
+ * @param	len Cantidad de bytes a enviar
+ * @return  La cantidad de bytes enviados, o 1 si se consulta y la UART esta lista
+ */
+/**************************************************************************/
+static UINT forwardToUart(const BYTE *data, UINT len)
+{
+	if (len == 0)	return 1;	// La UART siempre acepta datos
+
+	UART_WriteBytes(data, len);
+	return len;
+}
@@ -104,6 +104,21 @@ void UART_Write(const char *str)
 	uartWriteString(menuUart, str);
 }
 
+/*!
+ * @brief   Escribe datos binarios en la UART, que pueden no terminar en cero
+ * @param	data
+ * 			Los datos a escribir
+ * @param	len
+ * 			La cantidad de bytes
+ */
+void UART_WriteBytes(const uint8_t *data, uint32_t len)
+{
+	while (len--)
+	{
+		uartWriteByte(menuUart, *data++);
+	}
+}
+
 /*!
  * @brief   Detecta si hay algun byte sin leer en el buffer de la UART
  * @return  TRUE si hay algun byte disponible para leer desde la UART
@@ -0,0 +1,19 @@
+/*
+ *  board.h
+ *
+ *  Reemplazo del board.h de LPCOpen para compilar fsS25FL.c y FatFs en la
+ *  PC con las pruebas del host. Solo define lo que usa el sistema de
+ *  archivos.
+ */
+
+#ifndef _BOARD_H_
+#define _BOARD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef MIN
+#define MIN(a, b)           (((a) < (b)) ? (a) : (b))
+#endif
+
+#endif  //_BOARD_H_
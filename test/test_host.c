@@ -0,0 +1,877 @@
+/*
+ *  test_host.c
+ *
+ *  Created on: 17-09-2021
+ *  Author: Martin Rios - jrios@fi.uba.ar
+ *
+ *  Pruebas del driver en la PC sobre las memorias emuladas del puerto del
+ *  host (ver S25FL_host_port.h). Se compilan y se corren con:
+ *
+ *      make -C test
+ *
+ *  El programa devuelve 0 si pasaron todas las comprobaciones.
+ */
+
+#include "S25FL_host_port.h"
+#include "S25FL_stripe.h"
+#include "fsS25FL.h"
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_SIZE           (8UL << 20)     // Capacidad de cada memoria emulada
+#define TEST_SECTOR         4096
+#define TEST_LEN            20000           // Bytes de las lecturas y escrituras largas
+
+#define CHECK(cond)         _check((cond), #cond, __LINE__)
+
+static s25fl_dev_t flash, flash2;
+static uint8_t pattern[2 * TEST_LEN];
+static uint8_t data[2 * TEST_LEN];
+static uint32_t checks, failures;
+
+static bool _check(bool ok, const char *expr, int line);
+static s25fl_t _config(s25fl_read_mode_t mode, s25fl_lanes_t lanes);
+static s25fl_t _sspConfig(void);
+static bool _fill(s25fl_dev_t *dev, uint32_t address, uint32_t len);
+static bool _sink(const uint8_t *chunk, uint32_t len, void *ctx);
+
+/**************************************************************************/
+/*!
+    @brief      Lee con cada modo de lectura, con y sin lectura continua y
+                con el puerto por transacciones completas o por fases.
+*/
+/**************************************************************************/
+static void _testReadModes(void)
+{
+    host_port_stats_t stats;
+    s25fl_t config;
+    uint8_t mode, continuous, phases;
+
+    init_host_port(TEST_SIZE, S25FL_LANES_4);
+    CHECK(S25FL_InitDriver(&flash, _config(S25FL_READ_FAST, S25FL_LANES_4)));
+    CHECK(_fill(&flash, 0, TEST_LEN));
+
+    for (mode = S25FL_READ_NORMAL; mode < S25FL_READ_MODES; mode++)
+    {
+        for (continuous = 0; continuous < 2; continuous++)
+        {
+            for (phases = 0; phases < 2; phases++)
+            {
+                config = _config((s25fl_read_mode_t)mode, S25FL_LANES_4);
+                config.continuous_read = continuous;
+                if (phases) config.spi_transfer_fnc = NULL;
+                if (!CHECK(S25FL_InitDriver(&flash, config))) continue;
+
+                resetStats_host_port();
+                memset(data, 0, TEST_LEN);
+                CHECK(S25FL_readBuffer(&flash, 3, data, TEST_LEN - 3) == TEST_LEN - 3);
+                CHECK(memcmp(data, pattern + 3, TEST_LEN - 3) == 0);
+                CHECK(S25FL_readBuffer(&flash, 1000, data, 10) == 10);
+                CHECK(memcmp(data, pattern + 1000, 10) == 0);
+
+                getStats_host_port(&stats);
+                CHECK(stats.laneErrors == 0);
+                if (continuous && (mode == S25FL_READ_DUAL_IO || mode == S25FL_READ_QUAD_IO))
+                {
+                    CHECK(stats.continuousReads > 0);
+                }
+                else
+                {
+                    CHECK(stats.continuousReads == 0);
+                }
+            }
+        }
+    }
+
+    // Con menos lineas cableadas el modo automatico no usa las que faltan
+    init_host_port(TEST_SIZE, S25FL_LANES_2);
+    CHECK(S25FL_InitDriver(&flash, _config(S25FL_READ_AUTO, S25FL_LANES_2)));
+    CHECK(flash.config.read_mode == S25FL_READ_DUAL_IO);
+}
+
+/**************************************************************************/
+/*!
+    @brief      Lecturas dispersas: los segmentos cercanos se agrupan en un
+                solo comando sin pasar de S25FL_READV_SPAN bytes.
+*/
+/**************************************************************************/
+static void _testReadv(void)
+{
+    host_port_stats_t stats;
+    s25fl_segment_t segments[6];
+    uint8_t buffers[6][64];
+    uint32_t address[6] = { 500, 100, 130, 160, 300, 5000 };
+    uint32_t len[6] = { 64, 20, 20, 20, 64, 64 };
+    uint32_t i, total = 0;
+
+    init_host_port(TEST_SIZE, S25FL_LANES_1);
+    CHECK(S25FL_InitDriver(&flash, _config(S25FL_READ_FAST, S25FL_LANES_1)));
+    CHECK(_fill(&flash, 0, TEST_LEN));
+
+    // Tres segmentos con huecos cortos: un solo comando
+    for (i = 0; i < 3; i++)
+    {
+        segments[i].address = address[i + 1];
+        segments[i].buffer = buffers[i];
+        segments[i].len = len[i + 1];
+        total += len[i + 1];
+    }
+    resetStats_host_port();
+    CHECK(S25FL_readv(&flash, segments, 3) == total);
+    getStats_host_port(&stats);
+    CHECK(stats.commands == 1);
+    for (i = 0; i < 3; i++)
+    {
+        CHECK(memcmp(segments[i].buffer, pattern + segments[i].address, segments[i].len) == 0);
+    }
+
+    // Segmentos desordenados, algunos cuyo grupo pasaria de S25FL_READV_SPAN
+    total = 0;
+    for (i = 0; i < 6; i++)
+    {
+        segments[i].address = address[i];
+        segments[i].buffer = buffers[i];
+        segments[i].len = len[i];
+        memset(buffers[i], 0, sizeof(buffers[i]));
+        total += len[i];
+    }
+    CHECK(S25FL_readv(&flash, segments, 6) == total);
+    for (i = 0; i < 6; i++)
+    {
+        CHECK(memcmp(segments[i].buffer, pattern + segments[i].address, segments[i].len) == 0);
+    }
+
+    // Un segmento fuera de la memoria invalida toda la lectura
+    segments[0].address = TEST_SIZE - 10;
+    segments[0].len = 64;
+    CHECK(S25FL_readv(&flash, segments, 1) == 0);
+    CHECK(S25FL_lastError(&flash) == S25FL_ERR_PARAM);
+}
+
+/**************************************************************************/
+/*!
+    @brief      Perfil armado desde la tabla SFDP de la memoria emulada, y
+                los casos en que se conserva el perfil de la familia.
+*/
+/**************************************************************************/
+static void _testSfdp(void)
+{
+    const s25fl_profile_t *profile;
+    uint8_t blob[16 + 4 * S25FL_SFDP_BFPT_DWORDS];
+
+    init_host_port(TEST_SIZE, S25FL_LANES_4);
+    CHECK(S25FL_InitDriver(&flash, _config(S25FL_READ_AUTO, S25FL_LANES_4)));
+    profile = S25FL_profile(&flash);
+    CHECK(profile == &flash.sfdp);
+    CHECK(profile->capacity == TEST_SIZE);
+    CHECK(profile->addrBytes == 3);
+    CHECK(profile->pageSize == 256);
+    CHECK(profile->sectorSize == TEST_SECTOR);
+    CHECK(profile->readCmds[S25FL_READ_QUAD_IO].opcode == S25FL_CMD_FREADQUADIO);
+    CHECK(profile->readCmds[S25FL_READ_QUAD_IO].modeCycles == S25FL_QUADIO_MODE_CYCLES);
+    CHECK(flash.config.read_mode == S25FL_READ_QUAD_IO);
+    CHECK(_fill(&flash, 0, TEST_LEN));
+
+    // Ciclos de latencia que no forman bytes: se usa la tabla de la familia
+    CHECK(S25FL_readSfdp(&flash, 0, blob, sizeof(blob)) == sizeof(blob));
+    blob[16 + 8] = 10 | (2 << 5);
+    sfdp_host_port(blob, sizeof(blob));
+    CHECK(S25FL_InitDriver(&flash, _config(S25FL_READ_QUAD_IO, S25FL_LANES_4)));
+    CHECK(flash.sfdpReads[S25FL_READ_QUAD_IO].dummyCycles == S25FL_QUADIO_DUMMY_CYCLES);
+    CHECK(S25FL_readBuffer(&flash, 0, data, TEST_LEN) == TEST_LEN);
+    CHECK(memcmp(data, pattern, TEST_LEN) == 0);
+
+    // Paginas mayores que el buffer de S25FL_append: se conserva la tabla y
+    // se programa de a S25FL_PAGESIZE bytes
+    blob[16 + 8] = S25FL_QUADIO_DUMMY_CYCLES | (S25FL_QUADIO_MODE_CYCLES << 5);
+    blob[16 + 40] = (blob[16 + 40] & 0x0F) | (9 << 4);
+    sfdp_host_port(blob, sizeof(blob));
+    CHECK(S25FL_InitDriver(&flash, _config(S25FL_READ_AUTO, S25FL_LANES_4)));
+    CHECK(S25FL_profile(&flash) == &flash.sfdp);
+    CHECK(S25FL_pageSize(&flash) == S25FL_PAGESIZE);
+    CHECK(_fill(&flash, 0, TEST_LEN));
+    CHECK(S25FL_readBuffer(&flash, 0, data, TEST_LEN) == TEST_LEN);
+    CHECK(memcmp(data, pattern, TEST_LEN) == 0);
+
+    // Sin tabla SFDP la capacidad sale del JEDEC ID
+    sfdp_host_port(NULL, 0);
+    CHECK(S25FL_InitDriver(&flash, _config(S25FL_READ_AUTO, S25FL_LANES_4)));
+    CHECK(S25FL_profile(&flash) != &flash.sfdp);
+    CHECK(S25FL_capacity(&flash) == TEST_SIZE);
+}
+
+/**************************************************************************/
+/*!
+    @brief      Lecturas durante un borrado: fuera de la region borrada se
+                suspende y se reanuda, dentro se espera a que termine.
+*/
+/**************************************************************************/
+static void _testSuspend(void)
+{
+    host_port_stats_t stats;
+    s25fl_handle_t handle;
+    s25fl_t config;
+    uint8_t *memory;
+    uint32_t start, i;
+    bool blank = true;
+
+    init_host_port(TEST_SIZE, S25FL_LANES_1);
+    config = _config(S25FL_READ_FAST, S25FL_LANES_1);
+    config.suspend_reads = true;
+    CHECK(S25FL_InitDriver(&flash, config));
+    memory = memory_host_port(0);
+    memset(memory, 0x11, 8 * TEST_SECTOR);
+
+    resetStats_host_port();
+    CHECK(S25FL_startErase(&flash, &handle, 5 * TEST_SECTOR, TEST_SECTOR, NULL, NULL) == S25FL_OK);
+
+    // Fuera de la region: se lee sin esperar el borrado (tSE de 45 ms)
+    start = timeUs_host_port();
+    CHECK(S25FL_readBuffer(&flash, 6 * TEST_SECTOR, data, 64) == 64);
+    CHECK(data[0] == 0x11 && data[63] == 0x11);
+    CHECK(timeUs_host_port() - start < 5000);
+    CHECK(handle.state == S25FL_HANDLE_RUNNING);
+
+    // Dentro de la region: se espera y se leen los datos ya borrados
+    CHECK(S25FL_readBuffer(&flash, 5 * TEST_SECTOR + 100, data, 64) == 64);
+    CHECK(data[0] == 0xFF && data[63] == 0xFF);
+
+    while (S25FL_poll(&flash, &handle) == S25FL_HANDLE_RUNNING)  delayUs_host_port(100);
+    CHECK(handle.state == S25FL_HANDLE_DONE);
+    for (i = 0; i < TEST_SECTOR; i++)   blank &= (memory[5 * TEST_SECTOR + i] == 0xFF);
+    CHECK(blank);
+    CHECK(memory[4 * TEST_SECTOR] == 0x11 && memory[6 * TEST_SECTOR] == 0x11);
+
+    getStats_host_port(&stats);
+    CHECK(stats.suspendedReads == 0);
+    CHECK(stats.suspendErrors == 0);
+}
+
+/**************************************************************************/
+/*!
+    @brief      Dispositivo intercalado sobre las dos memorias emuladas,
+                con la cache de lectura que deja lineas pendientes.
+*/
+/**************************************************************************/
+static void _testStripe(void)
+{
+    host_port_stats_t stats;
+    s25fl_stripe_t stripe;
+    s25fl_t config;
+    uint32_t i, address, got = 0;
+    bool ok = true;
+
+    init_host_port(TEST_SIZE, S25FL_LANES_4);
+    config = _config(S25FL_READ_QUAD_IO, S25FL_LANES_4);
+    config.read_cache = true;
+    config.spi_transfer_fnc = NULL;
+    CHECK(S25FL_InitDriver(&flash, config));
+    config.chip_select_ctrl = chipSelect2_host_port;
+    CHECK(S25FL_InitDriver(&flash2, config));
+    CHECK(S25FL_stripeInit(&stripe, &flash, &flash2));
+    CHECK(S25FL_stripeSize(&stripe) == 2 * TEST_SIZE);
+
+    resetStats_host_port();
+    CHECK(S25FL_stripeErase(&stripe, 0, 2 * 5 * TEST_SECTOR));
+    CHECK(S25FL_stripeWrite(&stripe, 100, pattern, 2 * TEST_LEN) == 2 * TEST_LEN);
+
+    // Los sectores pares quedan en la primera memoria y los impares en la segunda
+    CHECK(memcmp(memory_host_port(0) + TEST_SECTOR, pattern + 2 * TEST_SECTOR - 100, 64) == 0);
+    CHECK(memcmp(memory_host_port(1), pattern + TEST_SECTOR - 100, 64) == 0);
+
+    CHECK(S25FL_stripeRead(&stripe, 100, data, 2 * TEST_LEN) == 2 * TEST_LEN);
+    CHECK(memcmp(data, pattern, 2 * TEST_LEN) == 0);
+
+    // Lecturas cortas alternando entre las memorias
+    for (i = 0; i < 200; i++)
+    {
+        address = 100 + (i * 4099) % (2 * TEST_LEN - 32);
+        S25FL_stripeRead(&stripe, address, data, 20);
+        ok &= (memcmp(data, pattern + address - 100, 20) == 0);
+    }
+    CHECK(ok);
+
+    memset(data, 0, 2 * TEST_LEN);
+    CHECK(S25FL_stripeReadStream(&stripe, 100, 2 * TEST_LEN, _sink, &got) == 2 * TEST_LEN);
+    CHECK(memcmp(data, pattern, 2 * TEST_LEN) == 0);
+    CHECK(S25FL_stripeStatus(&stripe) == 0);
+
+    getStats_host_port(&stats);
+    CHECK(stats.busConflicts == 0);
+    CHECK(stats.laneErrors == 0);
+}
+
+/**************************************************************************/
+/*!
+    @brief      Puerto por el SSP emulado, con el FIFO cargado como en la
+                CIAA y frame a frame: mismos datos, sin desbordes, y menos
+                tiempo sin clock con el FIFO cargado.
+*/
+/**************************************************************************/
+static void _testSsp(void)
+{
+    host_port_stats_t stats;
+    uint64_t gap[2];
+    uint8_t primed;
+
+    for (primed = 0; primed < 2; primed++)
+    {
+        init_host_port(TEST_SIZE, S25FL_LANES_1);
+        sspPrimed_host_port(primed);
+        if (!CHECK(S25FL_InitDriver(&flash, _sspConfig())))    continue;
+
+        resetStats_host_port();
+        CHECK(_fill(&flash, TEST_SECTOR, TEST_LEN));
+        memset(data, 0, TEST_LEN);
+        CHECK(S25FL_readBuffer(&flash, TEST_SECTOR, data, TEST_LEN) == TEST_LEN);
+        CHECK(memcmp(data, pattern, TEST_LEN) == 0);
+        CHECK(memcmp(memory_host_port(0) + TEST_SECTOR, pattern, TEST_LEN) == 0);
+
+        getStats_host_port(&stats);
+        CHECK(stats.sspOverruns == 0);
+        gap[primed] = stats.sspGapNs;
+    }
+    sspPrimed_host_port(true);
+
+    CHECK(gap[1] < gap[0]);
+}
+
+/**************************************************************************/
+/*!
+    @brief      Fallas inyectadas en programaciones y borrados: los bits
+                P_ERR y E_ERR reportados, el CLSR que los borra, la
+                politica de verificacion y el error que queda registrado.
+*/
+/**************************************************************************/
+static void _testFaults(void)
+{
+    s25fl_t config;
+    uint8_t *memory;
+
+    init_host_port(TEST_SIZE, S25FL_LANES_1);
+    config = _config(S25FL_READ_FAST, S25FL_LANES_1);
+    CHECK(S25FL_InitDriver(&flash, config));
+    memory = memory_host_port(0);
+    CHECK(S25FL_eraseSector(&flash, 0));
+
+    // Con S25FL_VERIFY_SR2 (por defecto) se detectan las fallas reportadas
+    fault_host_port(0, HOST_FAULT_REPORTED);
+    CHECK(S25FL_writePage(&flash, 0, pattern, 256, false) == 0);
+    CHECK(S25FL_lastError(&flash) == S25FL_ERR_PROGRAM);
+    CHECK(memory[0] == 0xFF && memory[255] == 0xFF);
+
+    // El CLSR borro P_ERR: la siguiente programacion no arrastra el error
+    CHECK(S25FL_writePage(&flash, 0, pattern, 256, false) == 256);
+    CHECK(memcmp(memory, pattern, 256) == 0);
+
+    fault_host_port(0, HOST_FAULT_REPORTED);
+    CHECK(!S25FL_eraseSector(&flash, 0));
+    CHECK(S25FL_lastError(&flash) == S25FL_ERR_ERASE);
+    CHECK(memcmp(memory, pattern, 256) == 0);
+    CHECK(S25FL_eraseSector(&flash, 0));
+    CHECK(memory[0] == 0xFF && memory[255] == 0xFF);
+
+    // Una falla que la memoria no reporta pasa con S25FL_VERIFY_SR2...
+    fault_host_port(0, HOST_FAULT_SILENT);
+    CHECK(S25FL_writePage(&flash, 0, pattern, 256, false) == 256);
+    CHECK(memory[0] == 0xFF);
+
+    // ...y la detecta la relectura, en programaciones y en borrados
+    config.verify = S25FL_VERIFY_READBACK;
+    CHECK(S25FL_InitDriver(&flash, config));
+    fault_host_port(0, HOST_FAULT_SILENT);
+    CHECK(S25FL_writePage(&flash, 0, pattern, 256, false) == 0);
+    CHECK(S25FL_lastError(&flash) == S25FL_ERR_VERIFY);
+    CHECK(S25FL_writePage(&flash, 0, pattern, 256, false) == 256);
+    fault_host_port(0, HOST_FAULT_SILENT);
+    CHECK(!S25FL_eraseSector(&flash, 0));
+    CHECK(S25FL_lastError(&flash) == S25FL_ERR_VERIFY);
+
+    // Sin verificacion no se consulta SR2: la falla reportada no se ve, y
+    // el CLSR de la inicializacion siguiente borra el bit que quedo fijo
+    config.verify = S25FL_VERIFY_NONE;
+    CHECK(S25FL_InitDriver(&flash, config));
+    fault_host_port(0, HOST_FAULT_REPORTED);
+    CHECK(S25FL_eraseSector(&flash, 0));
+    CHECK(memcmp(memory, pattern, 256) == 0);
+
+    config.verify = S25FL_VERIFY_SR2;
+    CHECK(S25FL_InitDriver(&flash, config));
+    CHECK(S25FL_eraseSector(&flash, 0));
+    CHECK(memory[0] == 0xFF && memory[255] == 0xFF);
+}
+
+/**************************************************************************/
+/*!
+    @brief      Falla en la pagina N de una escritura encadenada: se
+                devuelven los N * pagesize bytes anteriores, aunque despues
+                de la pagina que fallo haya paginas en blanco sin enviar.
+*/
+/**************************************************************************/
+static void _testWriteFault(void)
+{
+    uint8_t pages[6 * 256];
+    uint32_t n, blank;
+
+    init_host_port(TEST_SIZE, S25FL_LANES_1);
+    CHECK(S25FL_InitDriver(&flash, _config(S25FL_READ_FAST, S25FL_LANES_1)));
+
+    for (blank = 0; blank < 2; blank++)
+    {
+        // Con blank, las paginas 4 y 5 quedan en 0xFF y no se programan
+        memcpy(pages, pattern, sizeof(pages));
+        if (blank)  memset(pages + 4 * 256, 0xFF, 2 * 256);
+
+        for (n = 0; n < 4; n++)
+        {
+            CHECK(S25FL_eraseSector(&flash, 0));
+            faultAfter_host_port(0, HOST_FAULT_REPORTED, n);
+            CHECK(S25FL_writeBuffer(&flash, 0, pages, sizeof(pages)) == n * 256);
+            CHECK(S25FL_lastError(&flash) == S25FL_ERR_PROGRAM);
+            CHECK(memcmp(memory_host_port(0), pages, n * 256) == 0);
+            CHECK(memory_host_port(0)[n * 256] == 0xFF);
+        }
+    }
+}
+
+/**************************************************************************/
+/*!
+    @brief      Prueba el acumulador de S25FL_append: una pagina parcial que
+                se completa en dos programaciones, registros que cruzan el
+                limite de la pagina y el plazo con la memoria todavia
+                programando la pagina anterior.
+*/
+/**************************************************************************/
+static void _testAppend(void)
+{
+    s25fl_append_t app;
+    host_port_stats_t stats;
+    const uint8_t *chip;
+    uint32_t t0;
+
+    init_host_port(TEST_SIZE, S25FL_LANES_1);
+    CHECK(S25FL_InitDriver(&flash, _config(S25FL_READ_FAST, S25FL_LANES_1)));
+    CHECK(S25FL_eraseSector(&flash, 0));
+    chip = memory_host_port(0);
+
+    // Pagina parcial: queda en RAM hasta S25FL_appendFlush
+    S25FL_appendInit(&flash, &app, 10, 0);
+    resetStats_host_port();
+    CHECK(S25FL_append(&flash, &app, pattern, 100) == 100);
+    getStats_host_port(&stats);
+    CHECK(stats.commands == 0);
+    CHECK(chip[10] == 0xFF);
+    CHECK(S25FL_appendFlush(&flash, &app));
+    CHECK(S25FL_readBuffer(&flash, 0, data, 256) == 256);
+    CHECK(memcmp(data + 10, pattern, 100) == 0);
+    CHECK(data[9] == 0xFF && data[110] == 0xFF);
+
+    // El resto de la misma pagina se programa despues sobre los 0xFF
+    CHECK(S25FL_append(&flash, &app, pattern + 100, 50) == 50);
+    CHECK(S25FL_appendFlush(&flash, &app));
+    CHECK(S25FL_readBuffer(&flash, 10, data, 150) == 150);
+    CHECK(memcmp(data, pattern, 150) == 0);
+
+    // Cruzando el limite: la primera pagina se programa sola, sin esperar
+    // a que termine, y la segunda queda en RAM
+    S25FL_appendInit(&flash, &app, 200, 0);
+    t0 = timeUs_host_port();
+    CHECK(S25FL_append(&flash, &app, pattern, 300) == 300);
+    CHECK(timeUs_host_port() - t0 < 200);
+    CHECK(memcmp(chip + 200, pattern, 56) == 0);
+    CHECK(chip[256] == 0xFF);
+    CHECK(S25FL_appendFlush(&flash, &app));
+    CHECK(S25FL_readBuffer(&flash, 200, data, 300) == 300);
+    CHECK(memcmp(data, pattern, 300) == 0);
+
+    // Plazo vencido con la memoria ocupada: S25FL_appendPoll espera que
+    // termine la pagina anterior antes de programar la parcial
+    S25FL_appendInit(&flash, &app, 1024, 50);
+    CHECK(S25FL_append(&flash, &app, pattern, 256 + 20) == 256 + 20);
+    CHECK(S25FL_appendPoll(&flash, &app));
+    CHECK(chip[1024 + 256] == 0xFF);
+    delayUs_host_port(60);
+    CHECK(S25FL_appendPoll(&flash, &app));
+    CHECK(app.len == 0);
+    CHECK(S25FL_readBuffer(&flash, 1024, data, 256 + 20) == 256 + 20);
+    CHECK(memcmp(data, pattern, 256 + 20) == 0);
+}
+
+/**************************************************************************/
+/*!
+    @brief      Deja la memoria sin accesos mas de idle_powerdown_us y
+                comprueba que los accesos siguientes la despiertan, con y
+                sin S25FL_wakeHint, sin enviarle comandos que ignora.
+*/
+/**************************************************************************/
+static void _testIdle(void)
+{
+    s25fl_t config = _config(S25FL_READ_QUAD_IO, S25FL_LANES_4);
+    s25fl_power_stats_t power;
+    host_port_stats_t stats;
+    uint64_t waited;
+
+    config.idle_powerdown_us = 1000;
+    init_host_port(TEST_SIZE, S25FL_LANES_4);
+    CHECK(S25FL_InitDriver(&flash, config));
+    CHECK(_fill(&flash, 0, TEST_LEN));
+    CHECK(!S25FL_idleTask(&flash));
+
+    // Lectura con la memoria en deep power-down: la despierta el acceso
+    resetStats_host_port();
+    delayUs_host_port(1500);
+    CHECK(S25FL_idleTask(&flash));
+    CHECK(S25FL_readBuffer(&flash, 0, data, TEST_LEN) == TEST_LEN);
+    CHECK(memcmp(data, pattern, TEST_LEN) == 0);
+    S25FL_powerStats(&flash, &power);
+    CHECK(power.powerDowns == 1);
+    CHECK(power.demandWakes == 1);
+    waited = power.wakeWaitUs;
+    CHECK(waited > 0);
+
+    // Con S25FL_wakeHint la salida de deep power-down ya termino al leer
+    delayUs_host_port(1500);
+    CHECK(S25FL_idleTask(&flash));
+    S25FL_wakeHint(&flash);
+    delayUs_host_port(100);
+    CHECK(S25FL_readBuffer(&flash, 100, data, 1000) == 1000);
+    CHECK(memcmp(data, pattern + 100, 1000) == 0);
+    S25FL_powerStats(&flash, &power);
+    CHECK(power.powerDowns == 2);
+    CHECK(power.hintedWakes == 1);
+    CHECK(power.wakeWaitUs == waited);
+
+    // Tambien las escrituras despiertan a la memoria
+    delayUs_host_port(1500);
+    CHECK(S25FL_idleTask(&flash));
+    CHECK(_fill(&flash, TEST_SECTOR, 300));
+    CHECK(S25FL_readBuffer(&flash, TEST_SECTOR, data, 300) == 300);
+    CHECK(memcmp(data, pattern, 300) == 0);
+
+    getStats_host_port(&stats);
+    CHECK(stats.powerDownErrors == 0);
+}
+
+/**************************************************************************/
+/*!
+    @brief      Mapea una region, con el puerto del host y con la copia en
+                un buffer, escribe dentro y fuera de ella y comprueba el
+                aviso de invalidacion y los datos al volver a mapearla.
+*/
+/**************************************************************************/
+static void _testMap(void)
+{
+    s25fl_t config = _config(S25FL_READ_FAST, S25FL_LANES_1);
+    s25fl_map_t map;
+    host_port_stats_t stats;
+    const uint8_t *view;
+    uint8_t copy[512], zeros[2] = {0};
+    uint8_t i;
+
+    config.spi_map_fnc = spiMap_host_port;
+    config.spi_map_invalidate_fnc = spiMapInvalidate_host_port;
+    init_host_port(TEST_SIZE, S25FL_LANES_1);
+    CHECK(S25FL_InitDriver(&flash, config));
+    CHECK(_fill(&flash, 0, 2 * TEST_SECTOR));
+
+    // Sin copia: el puntero es la vista del puerto
+    resetStats_host_port();
+    view = S25FL_map(&flash, &map, 1000, sizeof(copy), NULL);
+    CHECK(view != NULL && memcmp(view, pattern + 1000, sizeof(copy)) == 0);
+    getStats_host_port(&stats);
+    CHECK(stats.mapped == 1);
+
+    // Escribir fuera de la region no la invalida
+    CHECK(S25FL_eraseSector(&flash, 1));
+    CHECK(!map.stale);
+
+    // Escribir dentro: aviso al puerto y ventana desactualizada
+    CHECK(S25FL_writeBuffer(&flash, 1200, zeros, 2) == 2);
+    CHECK(map.stale);
+    getStats_host_port(&stats);
+    CHECK(stats.mapInvalidations > 0);
+    view = S25FL_map(&flash, &map, 1000, sizeof(copy), NULL);
+    CHECK(view != NULL && !map.stale);
+    CHECK(view[200] == 0x00 && view[201] == 0x00);
+    CHECK(memcmp(view, pattern + 1000, 200) == 0);
+    S25FL_unmap(&flash, &map);
+
+    // Con copia en el buffer: los datos viejos siguen ahi hasta remapear
+    config.spi_map_fnc = NULL;
+    CHECK(S25FL_InitDriver(&flash, config));
+    view = S25FL_map(&flash, &map, 0, sizeof(copy), copy);
+    CHECK(view == copy && memcmp(copy, pattern, sizeof(copy)) == 0);
+    CHECK(S25FL_eraseSector(&flash, 0));
+    CHECK(map.stale);
+    CHECK(copy[0] == pattern[0]);
+    view = S25FL_map(&flash, &map, 0, sizeof(copy), copy);
+    CHECK(view == copy && !map.stale);
+    for (i = 0; i < 16; i++)    CHECK(copy[i * 32] == 0xFF);
+    S25FL_unmap(&flash, &map);
+    CHECK(flash.maps == NULL);
+}
+
+/**************************************************************************/
+/*!
+    @brief      Escribe las mismas paginas con y sin paginas en 0xFF, con
+                S25FL_writeBuffer, S25FL_writePage y S25FL_startProgram, y
+                comprueba que las paginas en blanco no envian comandos y que
+                los datos se leen igual.
+*/
+/**************************************************************************/
+static void _testBlankPages(void)
+{
+    uint8_t pages[8 * 256];
+    uint32_t commands[2], blank;
+    host_port_stats_t stats;
+    s25fl_handle_t handle;
+
+    init_host_port(TEST_SIZE, S25FL_LANES_1);
+    CHECK(S25FL_InitDriver(&flash, _config(S25FL_READ_FAST, S25FL_LANES_1)));
+
+    for (blank = 0; blank < 2; blank++)
+    {
+        // Con blank, las paginas 2, 3 y 6 quedan en 0xFF
+        memcpy(pages, pattern, sizeof(pages));
+        if (blank)
+        {
+            memset(pages + 2 * 256, 0xFF, 2 * 256);
+            memset(pages + 6 * 256, 0xFF, 256);
+        }
+
+        CHECK(S25FL_eraseSector(&flash, 0));
+        S25FL_blankPages(&flash, true);
+        resetStats_host_port();
+        CHECK(S25FL_writeBuffer(&flash, 0, pages, sizeof(pages)) == sizeof(pages));
+        getStats_host_port(&stats);
+        commands[blank] = stats.commands;
+        CHECK(S25FL_blankPages(&flash, true) == 3 * blank);
+        CHECK(S25FL_readBuffer(&flash, 0, data, sizeof(pages)) == sizeof(pages));
+        CHECK(memcmp(data, pages, sizeof(pages)) == 0);
+
+        // La operacion no bloqueante saltea las mismas paginas
+        CHECK(S25FL_eraseSector(&flash, 0));
+        CHECK(S25FL_startProgram(&flash, &handle, 0, pages, sizeof(pages), NULL, NULL) == S25FL_OK);
+        while (S25FL_poll(&flash, &handle) == S25FL_HANDLE_RUNNING)  delayUs_host_port(100);
+        CHECK(handle.state == S25FL_HANDLE_DONE);
+        CHECK(S25FL_blankPages(&flash, true) == 3 * blank);
+        CHECK(S25FL_readBuffer(&flash, 0, data, sizeof(pages)) == sizeof(pages));
+        CHECK(memcmp(data, pages, sizeof(pages)) == 0);
+    }
+
+    // Cada pagina programada cuesta al menos la habilitacion y el comando
+    CHECK(commands[1] + 3 * 2 <= commands[0]);
+
+    // Una pagina en blanco sola no llega al bus
+    resetStats_host_port();
+    CHECK(S25FL_writePage(&flash, 7 * 256, pages + 6 * 256, 256, false) == 256);
+    getStats_host_port(&stats);
+    CHECK(stats.commands == 0);
+    CHECK(S25FL_blankPages(&flash, false) == 1);
+}
+
+/**************************************************************************/
+/*!
+    @brief      Formatea y monta FatFs sobre las dos memorias intercaladas y
+                escribe sectores FAT por los tres caminos de
+                S25FL_FatFs_DiskWrite: datos identicos (no se escribe),
+                solo bits de 1 a 0 (se programa sin borrar) y bits que
+                vuelven a 1 (se borra y se reprograma el sector flash).
+*/
+/**************************************************************************/
+static void _testFs(void)
+{
+    s25fl_stripe_t stripe;
+    host_port_stats_t stats;
+    s25fl_t config;
+    FATFS fs;
+    FIL file;
+    UINT n;
+    DWORD sectors, sector;
+    uint8_t fat[2 * FAT_SECTOR_SIZE];
+
+    init_host_port(TEST_SIZE, S25FL_LANES_4);
+    config = _config(S25FL_READ_QUAD_IO, S25FL_LANES_4);
+    CHECK(S25FL_InitDriver(&flash, config));
+    config.chip_select_ctrl = chipSelect2_host_port;
+    CHECK(S25FL_InitDriver(&flash2, config));
+    CHECK(S25FL_stripeInit(&stripe, &flash, &flash2));
+
+    // Sin formato no se puede montar
+    CHECK(!S25FL_begin(&fs, &stripe));
+    CHECK(S25FL_format(&fs) == 0);
+    CHECK(S25FL_FatFs_DiskIoCtl(GET_SECTOR_COUNT, &sectors) == RES_OK);
+    CHECK(sectors == 2 * TEST_SIZE / FAT_SECTOR_SIZE);
+
+    // Un archivo de varios sectores flash, leido despues de volver a montar
+    CHECK(f_open(&file, "DATOS.BIN", FA_CREATE_NEW | FA_WRITE) == FR_OK);
+    CHECK(f_write(&file, pattern, TEST_LEN, &n) == FR_OK && n == TEST_LEN);
+    CHECK(f_close(&file) == FR_OK);
+    CHECK(S25FL_begin(&fs, &stripe));
+    memset(data, 0, TEST_LEN);
+    CHECK(f_open(&file, "DATOS.BIN", FA_READ) == FR_OK);
+    CHECK(f_read(&file, data, TEST_LEN, &n) == FR_OK && n == TEST_LEN);
+    CHECK(f_close(&file) == FR_OK);
+    CHECK(memcmp(data, pattern, TEST_LEN) == 0);
+
+    // Dos sectores FAT al final del disco, fuera de los archivos
+    sector = sectors - 4;
+    memcpy(fat, pattern, sizeof(fat));
+    CHECK(S25FL_FatFs_DiskWrite(fat, sector, 2) == RES_OK);
+
+    // Datos identicos: solo se leen
+    resetStats_host_port();
+    CHECK(S25FL_FatFs_DiskWrite(fat, sector, 2) == RES_OK);
+    getStats_host_port(&stats);
+    CHECK(stats.programs == 0 && stats.erases == 0);
+
+    // Bits de 1 a 0 en una pagina: se programa solo esa pagina
+    fat[300] &= 0x0F;
+    fat[301] = 0x00;
+    resetStats_host_port();
+    CHECK(S25FL_FatFs_DiskWrite(fat, sector, 2) == RES_OK);
+    getStats_host_port(&stats);
+    CHECK(stats.programs == 1 && stats.erases == 0);
+    CHECK(S25FL_FatFs_DiskRead(data, sector, 2) == RES_OK);
+    CHECK(memcmp(data, fat, sizeof(fat)) == 0);
+
+    // Bits que vuelven a 1 en el primer sector FAT: se borra el sector
+    // flash y se conserva el resto, incluido el segundo sector FAT
+    fat[301] = 0xFF;
+    resetStats_host_port();
+    CHECK(S25FL_FatFs_DiskWrite(fat, sector, 1) == RES_OK);
+    getStats_host_port(&stats);
+    CHECK(stats.erases == 1);
+    CHECK(S25FL_FatFs_DiskRead(data, sector, 2) == RES_OK);
+    CHECK(memcmp(data, fat, sizeof(fat)) == 0);
+
+    // El archivo sigue intacto
+    CHECK(f_open(&file, "DATOS.BIN", FA_READ) == FR_OK);
+    CHECK(f_read(&file, data, TEST_LEN, &n) == FR_OK && n == TEST_LEN);
+    CHECK(f_close(&file) == FR_OK);
+    CHECK(memcmp(data, pattern, TEST_LEN) == 0);
+}
+
+int main(void)
+{
+    uint32_t i, seed = 1;
+
+    for (i = 0; i < sizeof(pattern); i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        pattern[i] = seed >> 16;
+    }
+
+    _testReadModes();
+    _testReadv();
+    _testSfdp();
+    _testSuspend();
+    _testStripe();
+    _testSsp();
+    _testFaults();
+    _testWriteFault();
+    _testAppend();
+    _testIdle();
+    _testMap();
+    _testBlankPages();
+    _testFs();
+
+    printf("%u comprobaciones, %u fallidas\n", checks, failures);
+    return failures ? 1 : 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Cuenta una comprobacion e informa si fallo.
+
+    @return     El resultado de la comprobacion.
+*/
+/**************************************************************************/
+static bool _check(bool ok, const char *expr, int line)
+{
+    checks++;
+    if (!ok)
+    {
+        failures++;
+        printf("test_host.c:%d: fallo %s\n", line, expr);
+    }
+    return ok;
+}
+
+/**************************************************************************/
+/*!
+    @return     La configuracion del driver para la primera memoria emulada.
+*/
+/**************************************************************************/
+static s25fl_t _config(s25fl_read_mode_t mode, s25fl_lanes_t lanes)
+{
+    s25fl_t config;
+
+    memset(&config, 0, sizeof(config));
+    config.chip_select_ctrl = chipSelect_host_port;
+    config.spi_read_fnc = spiRead_host_port;
+    config.spi_write_fnc = spiWrite_host_port;
+    config.spi_writeByte_fnc = spiWriteByte_host_port;
+    config.spi_read_register = spiReadRegister_host_port;
+    config.delay_fnc = delay_host_port;
+    config.delay_us_fnc = delayUs_host_port;
+    config.time_us_fnc = timeUs_host_port;
+    config.spi_set_clock = spiSetClock_host_port;
+    config.spi_lanes_fnc = spiLanes_host_port;
+    config.spi_transfer_fnc = spiTransfer_host_port;
+    config.memory_size = S64MB;
+    config.max_lanes = lanes;
+    config.read_mode = mode;
+    return config;
+}
+
+/**************************************************************************/
+/*!
+    @return     La configuracion del driver por el SSP emulado, una sola
+                linea como en la CIAA.
+*/
+/**************************************************************************/
+static s25fl_t _sspConfig(void)
+{
+    s25fl_t config = _config(S25FL_READ_FAST, S25FL_LANES_1);
+
+    config.spi_read_fnc = sspRead_host_port;
+    config.spi_write_fnc = sspWrite_host_port;
+    config.spi_writeByte_fnc = sspWriteByte_host_port;
+    config.spi_read_register = sspReadRegister_host_port;
+    config.spi_transfer_fnc = sspTransfer_host_port;
+    config.spi_lanes_fnc = NULL;
+    return config;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Borra los sectores de un rango y lo programa con el patron.
+
+    @return     True si se borro y se programo todo el rango.
+*/
+/**************************************************************************/
+static bool _fill(s25fl_dev_t *dev, uint32_t address, uint32_t len)
+{
+    uint32_t first = address - address % TEST_SECTOR;
+    uint32_t last = (address + len + TEST_SECTOR - 1) / TEST_SECTOR * TEST_SECTOR;
+
+    if (!S25FL_eraseRange(dev, first, last - first))    return false;
+
+    return S25FL_writeBuffer(dev, address, pattern, len) == len;
+}
+
+/**************************************************************************/
+/*!
+    @brief      Consumidor de S25FL_stripeReadStream: copia cada bloque a
+                continuacion del anterior en data.
+*/
+/**************************************************************************/
+static bool _sink(const uint8_t *chunk, uint32_t len, void *ctx)
+{
+    uint32_t *got = (uint32_t*)ctx;
+
+    memcpy(data + *got, chunk, len);
+    *got += len;
+    return true;
+}
@@ -0,0 +1,120 @@
+/*
+ *  test_hpp.cpp
+ *
+ *  Created on: 17-09-2021
+ *  Author: Martin Rios - jrios@fi.uba.ar
+ *
+ *  Prueba de humo de la interfaz C++ (S25FL.hpp) sobre el puerto del host:
+ *  compila el template con S25FL_HostPort, comprueba que init() rechaza una
+ *  memoria con otra geometria y que la lectura directa al puerto y la del
+ *  driver en C devuelven los mismos datos.
+ */
+
+#include "S25FL_host_port.h"
+#include "S25FL.hpp"
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_LEN            5000
+
+#define CHECK(cond)         _check((cond), #cond, __LINE__)
+
+typedef S25FL<S25FL_HostPort<0>, S25FL128L_Geometry> Flash;
+
+static_assert(Flash::geometry::capacity == (16UL << 20), "S25FL128L: 16 MB");
+static_assert(Flash::geometry::sectors == 4096, "S25FL128L: sectores de 4 KB");
+static_assert(Flash::geometry::pageRemaining(0x1F0) == 16, "Paginas de 256 bytes");
+static_assert(S25FL256L_Geometry::fastReadOpcode() == S25FL_CMD_FREAD4, "Mas de 16 MB: Fast Read de 4 bytes");
+
+// Puerto del host que cuenta las transacciones que el template envia
+// directo; las del driver en C van por spi_transfer_fnc y no se cuentan
+struct CountingPort : S25FL_HostPort<0>
+{
+    static uint32_t transfers;
+
+    static bool transfer(const s25fl_xfer_t *xfer)
+    {
+        transfers++;
+        return S25FL_HostPort<0>::transfer(xfer);
+    }
+};
+
+uint32_t CountingPort::transfers;
+
+static Flash flash;
+static S25FL<CountingPort, S25FL128L_Geometry> counted;
+static uint8_t pattern[TEST_LEN + 100];
+static uint8_t direct[TEST_LEN], fallback[TEST_LEN];
+static uint32_t checks, failures;
+
+/**************************************************************************/
+/*!
+    @brief      Cuenta una comprobacion e informa si fallo.
+
+    @return     El resultado de la comprobacion.
+*/
+/**************************************************************************/
+static bool _check(bool ok, const char *expr, int line)
+{
+    checks++;
+    if (!ok)
+    {
+        failures++;
+        printf("test_hpp.cpp:%d: fallo %s\n", line, expr);
+    }
+    return ok;
+}
+
+int main(void)
+{
+    s25fl_t config = S25FL_HostPort<0>::config();
+    uint32_t i, seed = 1, before;
+
+    for (i = 0; i < sizeof(pattern); i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        pattern[i] = seed >> 16;
+    }
+    config.read_mode = S25FL_READ_FAST;
+
+    // Una S25FL064L no tiene la geometria del template
+    init_host_port(8UL << 20, S25FL_LANES_1);
+    CHECK(!flash.init(config));
+
+    init_host_port(16UL << 20, S25FL_LANES_1);
+    CHECK(flash.init(config));
+    CHECK(flash.eraseRange(0, 2 * Flash::geometry::sectorSize));
+    CHECK(flash.write(0, pattern, sizeof(pattern)) == sizeof(pattern));
+
+    // Lectura directa al puerto y lectura del driver en C
+    CHECK(flash.read(100, direct, TEST_LEN) == TEST_LEN);
+    CHECK(S25FL_readBuffer(flash.dev(), 100, fallback, TEST_LEN) == TEST_LEN);
+    CHECK(memcmp(direct, fallback, TEST_LEN) == 0);
+    CHECK(memcmp(direct, pattern + 100, TEST_LEN) == 0);
+
+    // La lectura directa va al puerto y cuenta como acceso para idleTask
+    CHECK(counted.init(config));
+    CountingPort::transfers = 0;
+    delayUs_host_port(1000);
+    before = timeUs_host_port();
+    memset(direct, 0, TEST_LEN);
+    CHECK(counted.read(7, direct, TEST_LEN) == TEST_LEN);
+    CHECK(CountingPort::transfers == 1);
+    CHECK(counted.dev()->lastAccess >= before);
+    CHECK(memcmp(direct, pattern + 7, TEST_LEN) == 0);
+
+    // Con la cache de lectura se usa S25FL_readBuffer, con los mismos datos
+    config.read_cache = true;
+    CHECK(counted.init(config));
+    CountingPort::transfers = 0;
+    memset(fallback, 0, TEST_LEN);
+    CHECK(counted.read(7, fallback, 20) == 20);
+    CHECK(CountingPort::transfers == 0);
+    CHECK(memcmp(fallback, pattern + 7, 20) == 0);
+
+    // Fuera de la memoria tambien se delega, y el largo se recorta
+    CHECK(counted.read(Flash::geometry::capacity - 10, fallback, 20) == 10);
+
+    printf("%u comprobaciones, %u fallidas\n", checks, failures);
+    return failures ? 1 : 0;
+}